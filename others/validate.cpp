@@ -9,63 +9,273 @@
 #include <fstream>
 #include <algorithm>
 #include <cmath>
+#include <vector>
+#include <deque>
+#include <set>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <chrono>
+#include <atomic>
+#include <memory>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sched.h>
 
 const int ISIZE=3;
 const int ISIZE_MAX=(1 << ISIZE) - 1;
 const int FSIZE=8;
 const int FSIZE_MAX=(1 << FSIZE) - 1;
 
-class fixed_t;
-std::ostream& operator<<(std::ostream& os, const fixed_t& f);
+//	The ASM square table (SQUARETABLE, $1000-$1FFF), filled like FILLSQUARES does
+//	Entry n holds the square of the number of magnitude n epsilons, as the 16 bits
+//	ASM representation. Squares are truncated, and overflows are NaN ($0001)
+const int SQUARETABLE_SIZE=2048;
 
-// A 11 bits fixed point class (3+8)
+constexpr std::array<uint16_t,SQUARETABLE_SIZE> make_squaretable()
+{
+	std::array<uint16_t,SQUARETABLE_SIZE> table{};
+	uint32_t num = 0;
+	uint32_t incr = 0;
+	int n = 0;
+
+	while (n!=SQUARETABLE_SIZE)
+	{
+		table[n++] = ((num>>8)<<1) & 0xffff;
+
+		//	num += 2*n+1, checking overflow after each half (as the ASM does)
+		num += incr;
+		if (num & 0x80000)
+			break;
+		incr++;
+		num += incr;
+		if (num & 0x80000)
+			break;
+	}
+
+	//	Rest of the table is NaN
+	while (n!=SQUARETABLE_SIZE)
+		table[n++] = 0x0001;
+
+	return table;
+}
+
+constexpr auto squaretable = make_squaretable();
+
+static_assert( squaretable[1] == 0x0000 );
+static_assert( squaretable[256] == 0x0200 );
+static_assert( squaretable[724] == 0x0FFE );
+static_assert( squaretable[725] == 0x0001 );
+
+//	Opt-in instrumentation of the iterations (compile with -DSTATS)
+//	Counters add up during a render, and are dumped and reset when its output ends:
+//	one JSON line in STATS_JSON_NAME and one CSV line in STATS_CSV_NAME per render
+//	(STATS also makes packed_t renders use the scalar iter, so they are counted)
+//	Without STATS, the macros are empty
+#ifdef STATS
+const int STATS_ROWS=8192;
+const char *STATS_JSON_NAME = "/tmp/mandel_stats.jsonl";
+const char *STATS_CSV_NAME = "/tmp/mandel_stats.csv";
+
+struct stats_t
+{
+	std::atomic<uint64_t> points_;			//	Calls to iter
+	std::atomic<uint64_t> iterations_;
+	std::atomic<uint64_t> histogram_[256];	//	Points by iteration count
+	std::atomic<uint64_t> nan_squared_;		//	Escapes because zx^2 or zy^2 overflows
+	std::atomic<uint64_t> nan_add_;			//	Escapes because zx or zy overflows
+	std::atomic<uint64_t> nan_norm_;		//	Escapes because zx^2+zy^2 overflows
+	std::atomic<uint64_t> cycles_;			//	Stops on the periodicity check
+	std::atomic<uint64_t> mul2_nan_;		//	mul2 early outs on a NaN square
+	std::atomic<uint64_t> row_ns_[STATS_ROWS];	//	Wall time of each row
+	int renders_ = 0;
+};
+
+stats_t stats;
+
+void stats_row( int row, std::chrono::steady_clock::time_point start )
+{
+	if (row<STATS_ROWS)
+		stats.row_ns_[row] += std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now()-start ).count();
+}
+
+void stats_reset()
+{
+	for (auto c:{ &stats.points_, &stats.iterations_, &stats.nan_squared_, &stats.nan_add_, &stats.nan_norm_, &stats.cycles_, &stats.mul2_nan_ })
+		*c = 0;
+	for (auto &h:stats.histogram_)
+		h = 0;
+	for (auto &r:stats.row_ns_)
+		r = 0;
+}
+
+void stats_dump( const std::string &description )
+{
+	//	The first render of a run starts new files
+	auto mode = stats.renders_ ? std::ios::app : std::ios::trunc;
+	std::ofstream json( STATS_JSON_NAME, mode );
+	std::ofstream csv( STATS_CSV_NAME, mode );
+	if (!json || !csv)
+	{
+		std::cerr << "Cannot open stats files" << std::endl;
+		return;
+	}
+
+	std::string d = description;
+	for (size_t p=0;(p=d.find( '\n', p ))!=std::string::npos;)
+		d.replace( p, 1, "\\n" );
+	int rows = STATS_ROWS;
+	while (rows>0 && !stats.row_ns_[rows-1])
+		rows--;
+
+	json << "{ \"render\": " << stats.renders_ << ", \"place\": \"" << d << "\", \"points\": " << stats.points_
+		<< ", \"iterations\": " << stats.iterations_ << ", \"nan_squared\": " << stats.nan_squared_
+		<< ", \"nan_add\": " << stats.nan_add_ << ", \"nan_norm\": " << stats.nan_norm_
+		<< ", \"cycles\": " << stats.cycles_ << ", \"mul2_nan\": " << stats.mul2_nan_ << ", \"histogram\": [";
+	for (int i=0;i!=256;i++)
+		json << (i ? "," : "") << stats.histogram_[i];
+	json << "], \"row_ns\": [";
+	for (int i=0;i!=rows;i++)
+		json << (i ? "," : "") << stats.row_ns_[i];
+	json << "] }" << std::endl;
+
+	if (stats.renders_==0)
+	{
+		csv << "render,points,iterations,nan_squared,nan_add,nan_norm,cycles,mul2_nan";
+		for (int i=0;i!=256;i++)
+			csv << ",h" << i;
+		csv << std::endl;
+	}
+	csv << stats.renders_ << "," << stats.points_ << "," << stats.iterations_ << "," << stats.nan_squared_ << ","
+		<< stats.nan_add_ << "," << stats.nan_norm_ << "," << stats.cycles_ << "," << stats.mul2_nan_;
+	for (int i=0;i!=256;i++)
+		csv << "," << stats.histogram_[i];
+	csv << std::endl;
+
+	stats.renders_++;
+	stats_reset();
+}
+
+#define STATS_ADD(counter,n) (stats.counter.fetch_add( (n), std::memory_order_relaxed ))
+
+//	Records a point that ran i iterations and returned count
+//	A count different from i is a stop on the periodicity check
+//	An escape is attributed to the first NaN of the iteration: zx or zy, their squares, or the sum
+template <typename T> void stats_iter( int i, int count, bool escaped, T zx, T zy, T zx2, T zy2 )
+{
+	STATS_ADD( points_, 1 );
+	STATS_ADD( iterations_, i );
+	STATS_ADD( histogram_[count], 1 );
+	if (count!=i)
+		STATS_ADD( cycles_, 1 );
+	else if (!escaped)
+		;
+	else if (zx.is_nan() || zy.is_nan())
+		STATS_ADD( nan_add_, 1 );
+	else if (zx2.is_nan() || zy2.is_nan())
+		STATS_ADD( nan_squared_, 1 );
+	else
+		STATS_ADD( nan_norm_, 1 );
+}
+
+#define STATS_ITER(i,count,escaped,zx,zy,zx2,zy2) stats_iter( (i), (count), (escaped), (zx), (zy), (zx2), (zy2) )
+#define STATS_ROW_START auto stats_row_start = std::chrono::steady_clock::now()
+#define STATS_ROW_END(row) stats_row( (row), stats_row_start )
+#define STATS_DUMP(description) stats_dump( description )
+#define STATS_RESET() stats_reset()
+#else
+#define STATS_ADD(counter,n) ((void)0)
+#define STATS_ROW_START ((void)0)
+#define STATS_ROW_END(row) ((void)0)
+#define STATS_DUMP(description) ((void)0)
+#define STATS_RESET() ((void)0)
+#define STATS_ITER(i,count,escaped,zx,zy,zx2,zy2) ((void)0)
+#endif
+
+template <int IS, int FS> class basic_fixed_t;
+template <int IS, int FS> std::ostream& operator<<(std::ostream& os, const basic_fixed_t<IS,FS>& f);
+
+//	A fixed point class with IS integer bits and FS fractional bits
 //	External sign + NaN
-class fixed_t
+//	The magnitude is kept in the smallest of 16, 32 or 64 bits integers, and squared
+//	in an integer twice as large (128 bits for formats above 32 bits)
+//	fixed_t, the ASM format (3+8), squares with the ASM table
+template <int IS, int FS>
+class basic_fixed_t
 {
+	static_assert( IS>0 && FS>0 && IS+FS<=64 );
+
+public:
+	typedef std::conditional_t<IS+FS<=16, uint16_t, std::conditional_t<IS+FS<=32, uint32_t, uint64_t>> magnitude_t;
+	typedef std::conditional_t<IS+FS<=16, uint32_t, std::conditional_t<IS+FS<=32, uint64_t, unsigned __int128>> wide_t;
+	//	Floats are enough up to 23 bits (and keep the 3+8 conversions as they were)
+	typedef std::conditional_t<IS+FS<24, float, double> real_t;
+
+	static const int ISIZE = IS;
+	static const int FSIZE = FS;
+	static constexpr magnitude_t ISIZE_MAX = (magnitude_t(1) << IS) - 1;
+	static constexpr magnitude_t FSIZE_MAX = (magnitude_t(1) << FS) - 1;
+	static constexpr magnitude_t MAGNITUDE_MAX = (wide_t(1) << (IS+FS)) - 1;
+
+private:
 	bool sign_;
 	bool nan_;
-    unsigned int integer_ : ISIZE;
-    unsigned int fractional_ : FSIZE;
+	magnitude_t m_;
+
+	magnitude_t integer() const { return m_ >> FS; }
+	magnitude_t fractional() const { return m_ & FSIZE_MAX; }
 
 public:
-	fixed_t() : sign_(false), integer_(0), fractional_(0), nan_(false) {}
+	static basic_fixed_t from_magnitude( bool sign, magnitude_t m )
+	{
+		basic_fixed_t f;
+		f.sign_ = sign;
+		f.m_ = m;
+		return f;
+	}
+
+	//	In epsilons
+	magnitude_t magnitude() const { return m_; }
 
-	fixed_t(bool sign, int integer, int fractional, bool nan=false) : sign_(sign), integer_(integer), fractional_(fractional), nan_(nan)
+	basic_fixed_t() : sign_(false), nan_(false), m_(0) {}
+
+	basic_fixed_t(bool sign, magnitude_t integer, magnitude_t fractional, bool nan=false) : sign_(sign), nan_(nan)
 	{
 		// printf( "sign: %d, integer: %d, fractional: %d\n", sign, integer, fractional );
-		assert( integer >= 0 && integer <= ISIZE_MAX );
-		assert( fractional >= 0 && fractional <= FSIZE_MAX );
+		assert( integer <= ISIZE_MAX );
+		assert( fractional <= FSIZE_MAX );
+		m_ = (integer << FS) | fractional;
 	}
 
-	fixed_t(int integer, int fractional) : fixed_t(integer < 0, std::abs(integer), fractional) {}
+	basic_fixed_t(int integer, magnitude_t fractional) : basic_fixed_t(integer < 0, std::abs(integer), fractional) {}
 
-	fixed_t(float v)
+	basic_fixed_t(real_t v)
 	{
-// printf( "%f=>", v );	
 		bool sign = v<0;
 		int integer = static_cast<int>(std::abs(v));
-		int fractional = static_cast<int>((std::abs(v) - static_cast<int>(std::abs(v))) * (FSIZE_MAX+1.0) + 0.5);
-// printf( " [%d] ", fractional);
+		wide_t fractional = static_cast<wide_t>((std::abs(v) - static_cast<int>(std::abs(v))) * (FSIZE_MAX+1.0) + 0.5);
 		if (fractional > FSIZE_MAX)
 		{
 			integer++;
 			fractional = 0;
 		}
-		if (integer>ISIZE_MAX)
+		if (integer<0 || (wide_t)integer>ISIZE_MAX)
 		{
 			*this = nan();
 			return;
 		}
-		*this = fixed_t(sign, integer, fractional,false);
-// printf( "%s\n", to_string().c_str() );
+		*this = basic_fixed_t(sign, integer, fractional,false);
 	}
 
-	static fixed_t nan() { return fixed_t(false,0,0,true); }
-	static fixed_t epsilon( int count=1 ) { return fixed_t(0, count); }
+	static basic_fixed_t nan() { return basic_fixed_t(false,0,0,true); }
+	static basic_fixed_t epsilon( magnitude_t count=1 ) { return basic_fixed_t(0, count); }
 
     std::array<uint8_t, 2> get() const
     {
-        return {static_cast<uint8_t>(integer_), static_cast<uint8_t>(fractional_)};
+        return {static_cast<uint8_t>(integer()), static_cast<uint8_t>(fractional())};
     }
 
 	std::string to_string( bool verbose=true ) const
@@ -74,24 +284,31 @@ public:
 		{
 			return "<NaN>";
 		}
-		// return (sign_ ? "-" : "") + std::to_string(integer_ + fractional_ / (FSIZE_MAX+1.0))+"("+std::to_string(integer_)+":"+std::to_string(fractional_)+")";
 		if (!verbose)
-			return (sign_ ? "-" : "") + std::to_string(integer_ + fractional_ / (FSIZE_MAX+1.0));
-		return std::to_string(to_float())+"("+std::to_string(integer_)+":"+std::to_string(fractional_)+")";
+			return (sign_ ? "-" : "") + std::to_string(integer() + fractional() / (FSIZE_MAX+1.0));
+		return std::to_string(to_float())+"("+std::to_string(integer())+":"+std::to_string(fractional())+")";
 	}
 
-	std::string as_asm( const std::string separator=" ", const std::string prefix="" ) const
+	//	The 16 bits representation used by the ASM code
+	//	(two's complement, shifted left by one, low bit set for NaN)
+	int16_t packed() const
 	{
+		static_assert( IS+FS<=14 );
 		if (nan_)
 		{
-			return prefix+"01"+separator+prefix+"00";
+			return 0x0001;
 		}
 
-		int16_t v0 = ((integer_ << FSIZE) | fractional_)<<1;
+		int16_t v0 = m_<<1;
 
 		v0 *= (sign_ ? -1 : 1);
 
-		uint16_t v = v0;
+		return v0;
+	}
+
+	std::string as_asm( const std::string separator=" ", const std::string prefix="" ) const
+	{
+		uint16_t v = packed();
 
 		//	Return v as a 5 digits strings with the hex numbers, little endian
 		char buffer[128];
@@ -99,120 +316,114 @@ public:
 		return buffer;
 	}
 
-	float to_float() const
+	real_t to_float() const
 	{
 		assert( !is_nan() );
-		return (sign_ ? -1 : 1) * (integer_ + fractional_ / (FSIZE_MAX+1.0));
+		return (sign_ ? -1 : 1) * (integer() + fractional() / (FSIZE_MAX+1.0));
 	}
 
-	fixed_t set_sign(bool sign) const
+	basic_fixed_t set_sign(bool sign) const
 	{
-		return fixed_t(sign, integer_, fractional_,nan_);
+		basic_fixed_t f = *this;
+		f.sign_ = sign;
+		return f;
 	}
 
 	bool is_nan() const
 	{
-//		return integer_ == ISIZE_MAX && fractional_ == FSIZE_MAX;
 		return nan_;
 	}	
 
-	fixed_t times_positive( fixed_t other) const
+	basic_fixed_t times_positive( basic_fixed_t other) const
 	{
 		if (is_nan() || other.is_nan())
 		{
 			return nan();
 		}
-		return to_float()*other.to_float();
+		//	Rounded to the nearest epsilon
+		wide_t m = ((wide_t)m_ * other.m_ + (wide_t(1) << (FS-1))) >> FS;
+		if (m > MAGNITUDE_MAX)
+		{
+			return nan();
+		}
+		return from_magnitude(false, m);
 	}
 
-	fixed_t times(const fixed_t& other) const
+	basic_fixed_t times(const basic_fixed_t& other) const
 	{
 		bool sign = sign_ ^ other.sign_;
 		return times_positive(other).set_sign(sign);
 	}
 
-	bool compare_positive( const fixed_t& other) const
+	bool compare_positive( const basic_fixed_t& other) const
 	{
-		if (integer_ != other.integer_)
-		{
-			return integer_ < other.integer_;
-		}
-		return fractional_ < other.fractional_;
+		return m_ < other.m_;
 	}
 
-	bool operator<(const fixed_t& other) const
+	bool operator<(const basic_fixed_t& other) const
 	{
 		if (sign_ != other.sign_)
 		{
-			return sign_ ? -1 : +1;
+			return sign_;
+		}
+		if (sign_)
+		{
+			return other.abs().compare_positive(this->abs());
 		}
 
 		return this->abs().compare_positive(other.abs());
 	}
 
-	bool operator==(const fixed_t& other) const
+	bool operator==(const basic_fixed_t& other) const
 	{
 		assert( !is_nan() );
 		assert( !other.is_nan() );
-		return sign_ == other.sign_ && integer_ == other.integer_ && fractional_ == other.fractional_;
+		return sign_ == other.sign_ && m_ == other.m_;
 	}
 
-	bool operator!=(const fixed_t& other) const
+	bool operator!=(const basic_fixed_t& other) const
 	{
 		return !(*this == other);
 	}
 
-	fixed_t operator-() const
+	basic_fixed_t operator-() const
 	{
-		return fixed_t(!sign_, integer_, fractional_,nan_);
+		return set_sign(!sign_);
 	}
 
-	fixed_t abs() const
+	basic_fixed_t abs() const
 	{
-		return fixed_t(false, integer_, fractional_,nan_);
+		return set_sign(false);
 	}
 
 	// Adds two positive numbers
-	fixed_t add_positive( const fixed_t& other ) const
+	basic_fixed_t add_positive( const basic_fixed_t& other ) const
 	{
 		assert( sign_ == false );
 		assert( other.sign_ == false );
 
-		int integer = integer_ + other.integer_;
-		int fractional = fractional_ + other.fractional_;
-		if (fractional > FSIZE_MAX)
-		{
-			integer++;
-			fractional -= FSIZE_MAX+1;
-		}
-		if (integer > ISIZE_MAX)
+		wide_t m = (wide_t)m_ + other.m_;
+		if (m > MAGNITUDE_MAX)
 		{
 			return nan();
 		}
-		return fixed_t(integer, fractional);
+		return from_magnitude(false, m);
 	}
 
 	//	Subs a positive number froma larger one
-	fixed_t sub_positive( const fixed_t& other ) const
+	basic_fixed_t sub_positive( const basic_fixed_t& other ) const
 	{
 		assert( sign_ == false );
 		assert( other.sign_ == false );
 
-		int integer = integer_ - other.integer_;
-		int fractional = fractional_ - other.fractional_;
-		if (fractional < 0)
-		{
-			integer--;
-			fractional += FSIZE_MAX+1;
-		}
-		if (integer < 0)
+		if (m_ < other.m_)
 		{
 			return nan();
 		}
-		return fixed_t(integer, fractional);
+		return from_magnitude(false, m_ - other.m_);
 	}
 
-	fixed_t operator+(const fixed_t& other) const
+	basic_fixed_t operator+(const basic_fixed_t& other) const
 	{
 		// std::cout << "ADD " << *this << " + " << other << std::endl;
 
@@ -230,7 +441,6 @@ public:
 		//	Different sign (substraction)
 		auto xa = this->abs();
 		auto ya = other.abs();
-		fixed_t result;
 
 		//	Other wins
 		if (xa < ya)
@@ -241,58 +451,71 @@ public:
 		return xa.sub_positive(ya).set_sign(sign_);
 	}
 
-	fixed_t operator-(const fixed_t& other) const
+	basic_fixed_t operator-(const basic_fixed_t& other) const
 	{
 		return *this + (-other);
 	}
 
-	fixed_t squared() const
+	//	Truncated square, NaN on overflow
+	//	Bit exact with the ASM SQUARE routine (which it uses for the ASM format)
+	basic_fixed_t squared() const
 	{
-		return times(*this);
+		if (is_nan())
+		{
+			return nan();
+		}
+		if constexpr (IS==::ISIZE && FS==::FSIZE)
+		{
+			int v = squaretable[m_];
+			if (v & 1)
+			{
+				return nan();
+			}
+			return from_magnitude(false, v >> 1);
+		}
+		else
+		{
+			wide_t v = ((wide_t)m_ * m_) >> FS;
+			if (v > MAGNITUDE_MAX)
+			{
+				return nan();
+			}
+			return from_magnitude(false, v);
+		}
 	}
 
-	fixed_t div2() const
+	basic_fixed_t div2() const
 	{
 		assert( !is_nan() );
-
-		int integer = integer_;
-		int fractional = fractional_;
-
-		fractional >>= 1;
-		if (integer & 1)
-		{
-			fractional |= 1 << (FSIZE-1);
-		}
-
-		integer >>= 1;
-
-		return fixed_t(sign_, integer, fractional);
+		return from_magnitude(sign_, m_ >> 1);
 	}
 
 	bool is_even_epsilon()
 	{
-		return (fractional_ & 1) == 0;
+		return (m_ & 1) == 0;
 	}
 
 	//	Multiplies two numbers using only squares and add/subtract
 	//	Returns the double of the multiplication
-	fixed_t mul2(const fixed_t& other) const
+	basic_fixed_t mul2(const basic_fixed_t& other) const
 	{
 		// Multiplication using only squares and add/subtract
 		// (x-y)^2 = x^2 - 2xy + y^2
 		// 2xy = x^2 + y^2 - (x-y)^2
 		// xy = (x^2 + y^2 - (x-y)^2) / 2
 
-		fixed_t x = *this;
-		fixed_t y = other;
+		basic_fixed_t x = *this;
+		basic_fixed_t y = other;
 		auto x2 = x.squared();
 		if (x2.is_nan())
 		{
+			STATS_ADD( mul2_nan_, 1 );
 			return nan();
 		}
 		auto y2 = y.squared();
 		if (y2.is_nan())
 		{
+			STATS_ADD( mul2_nan_, 1 );
 			return nan();
 		}
 		auto xmy2 = (x - y).squared();
@@ -304,172 +527,402 @@ public:
 	}
 };
 
-std::ostream& operator<<(std::ostream& os, const fixed_t& f)
+template <int IS, int FS>
+std::ostream& operator<<(std::ostream& os, const basic_fixed_t<IS,FS>& f)
+{
+	os << f.to_string();
+	return os;
+}
+
+//	The ASM format
+typedef basic_fixed_t<ISIZE,FSIZE> fixed_t;
+
+//	Formats suggested in mandelbrot65.asm for a rewrite, and deeper ones to validate zooms
+typedef basic_fixed_t<3,9> fixed_3_9_t;
+typedef basic_fixed_t<4,12> fixed_4_12_t;
+typedef basic_fixed_t<5,11> fixed_5_11_t;
+typedef basic_fixed_t<4,28> fixed_4_28_t;
+typedef basic_fixed_t<4,56> fixed_4_56_t;
+
+const int PACKED_MAX=((ISIZE_MAX << FSIZE) | FSIZE_MAX) << 1;
+
+// A 16 bits fixed point class, packed the same way as the ASM numbers
+//	iiiiiiif fffffffN (two's complement, 7 bits integer, 8 bits fraction, N=1 for NaN)
+//	Same results as fixed_t, but every operation is integer only
+class packed_t
+{
+	int16_t v_;
+
+	static packed_t from_raw( int v )
+	{
+		packed_t p;
+		p.v_ = v;
+		return p;
+	}
+
+	//	Number of epsilons in the absolute value
+	int magnitude() const
+	{
+		return std::abs(v_) >> 1;
+	}
+
+public:
+	packed_t() : v_(0) {}
+
+	packed_t( const fixed_t &f ) : v_(f.packed()) {}
+
+	packed_t( float v ) : packed_t(fixed_t(v)) {}
+
+	static packed_t nan() { return from_raw(0x0001); }
+	static packed_t epsilon( int count=1 ) { return from_raw(count<<1); }
+	static packed_t raw( int16_t v ) { return from_raw(v); }
+
+	int16_t get() const { return v_; }
+
+	operator fixed_t() const
+	{
+		if (is_nan())
+		{
+			return fixed_t::nan();
+		}
+		int m = magnitude();
+		return fixed_t(v_<0, m >> FSIZE, m & FSIZE_MAX);
+	}
+
+	std::string to_string( bool verbose=true ) const
+	{
+		return fixed_t(*this).to_string(verbose);
+	}
+
+	std::string as_asm( const std::string separator=" ", const std::string prefix="" ) const
+	{
+		return fixed_t(*this).as_asm(separator, prefix);
+	}
+
+	float to_float() const
+	{
+		assert( !is_nan() );
+		return v_ / (2.0 * (FSIZE_MAX+1));
+	}
+
+	bool is_nan() const
+	{
+		return v_ & 1;
+	}
+
+	bool operator==(const packed_t& other) const
+	{
+		assert( !is_nan() );
+		assert( !other.is_nan() );
+		return v_ == other.v_;
+	}
+
+	bool operator!=(const packed_t& other) const
+	{
+		return !(*this == other);
+	}
+
+	packed_t operator-() const
+	{
+		if (is_nan())
+		{
+			return nan();
+		}
+		return from_raw(-v_);
+	}
+
+	packed_t abs() const
+	{
+		if (is_nan())
+		{
+			return nan();
+		}
+		return from_raw(std::abs(v_));
+	}
+
+	//	Saturates to NaN when leaving the 3.8 range, like fixed_t
+	packed_t operator+(const packed_t& other) const
+	{
+		if ((v_ | other.v_) & 1)
+		{
+			return nan();
+		}
+		int v = v_ + other.v_;
+		if (v > PACKED_MAX || v < -PACKED_MAX)
+		{
+			return nan();
+		}
+		return from_raw(v);
+	}
+
+	packed_t operator-(const packed_t& other) const
+	{
+		return *this + (-other);
+	}
+
+	//	Bit exact with the ASM SQUARE routine
+	packed_t squared() const
+	{
+		if (is_nan())
+		{
+			return nan();
+		}
+		return from_raw(squaretable[magnitude()]);
+	}
+
+	//	Halves the magnitude, keeping the sign (as fixed_t does)
+	packed_t div2() const
+	{
+		assert( !is_nan() );
+		int m = magnitude() >> 1;
+		return from_raw(v_<0 ? -(m<<1) : m<<1);
+	}
+
+	//	Returns the double of the multiplication, using only squares
+	packed_t mul2(const packed_t& other) const
+	{
+		auto x2 = squared();
+		if (x2.is_nan())
+		{
+			STATS_ADD( mul2_nan_, 1 );
+			return nan();
+		}
+		auto y2 = other.squared();
+		if (y2.is_nan())
+		{
+			STATS_ADD( mul2_nan_, 1 );
+			return nan();
+		}
+		auto xmy2 = (*this - other).squared();
+		return -xmy2 + x2 + y2;
+	}
+};
+
+std::ostream& operator<<(std::ostream& os, const packed_t& f)
 {
 	os << f.to_string();
 	return os;
 }
 
+template <typename F>
 void test_creation()
 {
 	//	Positive numbers
-	assert( fixed_t(1, 0) == fixed_t(1.0) );
-	assert( fixed_t(1, (FSIZE_MAX + 1) / 8) == fixed_t(1.125) );
-	assert( fixed_t(1, (FSIZE_MAX + 1) / 4) == fixed_t(1.25) );
-	assert( fixed_t(1, (FSIZE_MAX + 1) / 8 * 3) == fixed_t(1.375) );
-	assert( fixed_t(1, (FSIZE_MAX + 1) / 2) == fixed_t(1.5) );
-	assert( fixed_t(1, (FSIZE_MAX + 1) / 8 * 5) == fixed_t(1.625) );
-	assert( fixed_t(1, (FSIZE_MAX + 1) / 8 * 6) == fixed_t(1.75) );
-	assert( fixed_t(1, (FSIZE_MAX + 1) / 8 * 7) == fixed_t(1.875) );
-	assert( fixed_t(2, 0) == fixed_t(2.0) );
-	assert( fixed_t(0, (FSIZE_MAX + 1) / 8) == fixed_t(0.125) );
+	assert( F(1, 0) == F(1.0) );
+	assert( F(1, (F::FSIZE_MAX + 1) / 8) == F(1.125) );
+	assert( F(1, (F::FSIZE_MAX + 1) / 4) == F(1.25) );
+	assert( F(1, (F::FSIZE_MAX + 1) / 8 * 3) == F(1.375) );
+	assert( F(1, (F::FSIZE_MAX + 1) / 2) == F(1.5) );
+	assert( F(1, (F::FSIZE_MAX + 1) / 8 * 5) == F(1.625) );
+	assert( F(1, (F::FSIZE_MAX + 1) / 8 * 6) == F(1.75) );
+	assert( F(1, (F::FSIZE_MAX + 1) / 8 * 7) == F(1.875) );
+	assert( F(2, 0) == F(2.0) );
+	assert( F(0, (F::FSIZE_MAX + 1) / 8) == F(0.125) );
 
 	//	Negative numbers
-	assert( fixed_t(-1, 0) == fixed_t(-1.0) );
-	assert( fixed_t(-1, (FSIZE_MAX + 1) / 8) == fixed_t(-1.125) );
-	assert( fixed_t(-1, (FSIZE_MAX + 1) / 4) == fixed_t(-1.25) );
-	assert( fixed_t(-1, (FSIZE_MAX + 1) / 8 * 3) == fixed_t(-1.375) );
-	assert( fixed_t(-1, (FSIZE_MAX + 1) / 2) == fixed_t(-1.5) );
-	assert( fixed_t(-1, (FSIZE_MAX + 1) / 8 * 5) == fixed_t(-1.625) );
-	assert( fixed_t(-1, (FSIZE_MAX + 1) / 8 * 6) == fixed_t(-1.75) );
-	assert( fixed_t(-1, (FSIZE_MAX + 1) / 8 * 7) == fixed_t(-1.875) );
-	assert( fixed_t(-2, 0) == fixed_t(-2.0) );
-	assert( fixed_t(-2, (FSIZE_MAX + 1) / 2) == fixed_t(-2.5) );
+	assert( F(-1, 0) == F(-1.0) );
+	assert( F(-1, (F::FSIZE_MAX + 1) / 8) == F(-1.125) );
+	assert( F(-1, (F::FSIZE_MAX + 1) / 4) == F(-1.25) );
+	assert( F(-1, (F::FSIZE_MAX + 1) / 8 * 3) == F(-1.375) );
+	assert( F(-1, (F::FSIZE_MAX + 1) / 2) == F(-1.5) );
+	assert( F(-1, (F::FSIZE_MAX + 1) / 8 * 5) == F(-1.625) );
+	assert( F(-1, (F::FSIZE_MAX + 1) / 8 * 6) == F(-1.75) );
+	assert( F(-1, (F::FSIZE_MAX + 1) / 8 * 7) == F(-1.875) );
+	assert( F(-2, 0) == F(-2.0) );
+	assert( F(-2, (F::FSIZE_MAX + 1) / 2) == F(-2.5) );
 
 	//	Epsilons
-	assert(fixed_t::epsilon() == fixed_t(0, 1));
-	assert(fixed_t::epsilon(2) == fixed_t(0, 2));
-	assert(fixed_t::epsilon(3) == fixed_t(0, 3));
-	assert(fixed_t::epsilon(4) == fixed_t(0, 4));
-	assert(fixed_t::epsilon(5) == fixed_t(0, 5));
+	assert(F::epsilon() == F(0, 1));
+	assert(F::epsilon(2) == F(0, 2));
+	assert(F::epsilon(3) == F(0, 3));
+	assert(F::epsilon(4) == F(0, 4));
+	assert(F::epsilon(5) == F(0, 5));
 }
 
+template <typename F>
 void test_times()
 {
 	// test times_positive
-	assert( fixed_t(1, 0).times_positive(fixed_t(1, 0)) == fixed_t(1, 0) );
-	assert( fixed_t(1, 0).times_positive(fixed_t(1, 1)) == fixed_t(1, 1) );
-	assert( fixed_t(1, 0).times_positive(fixed_t(1, 2)) == fixed_t(1, 2) );
+	assert( F(1, 0).times_positive(F(1, 0)) == F(1, 0) );
+	assert( F(1, 0).times_positive(F(1, 1)) == F(1, 1) );
+	assert( F(1, 0).times_positive(F(1, 2)) == F(1, 2) );
 
 	//	Test floats
-	assert( fixed_t(1.5).times(fixed_t(1.5)) == fixed_t(2.25) );
-	assert( fixed_t(1.5).times(fixed_t(1.25)) == fixed_t(1.875) );
-	assert( fixed_t(1.5).times(fixed_t(1.75)) == fixed_t(2.625) );
-	assert( fixed_t(1.5).times(fixed_t(1.0)) == fixed_t(1.5) );
-	assert( fixed_t(1.5).times(fixed_t(2.0)) == fixed_t(3.0) );
-	assert( fixed_t(1.5).times(fixed_t(0.5)) == fixed_t(0.75) );
+	assert( F(1.5).times(F(1.5)) == F(2.25) );
+	assert( F(1.5).times(F(1.25)) == F(1.875) );
+	assert( F(1.5).times(F(1.75)) == F(2.625) );
+	assert( F(1.5).times(F(1.0)) == F(1.5) );
+	assert( F(1.5).times(F(2.0)) == F(3.0) );
+	assert( F(1.5).times(F(0.5)) == F(0.75) );
 
 	//	Multiply per zero
-	assert( fixed_t(1.5).times(fixed_t(0.0)) == fixed_t(0.0) );
+	assert( F(1.5).times(F(0.0)) == F(0.0) );
 
 	//	Mutiply per epsilon
-	assert( fixed_t(1.0).times(fixed_t::epsilon()) == fixed_t::epsilon() );
-	assert( fixed_t(1.0).times(fixed_t::epsilon(2)) == fixed_t::epsilon(2) );
-	assert( fixed_t(2.0).times(fixed_t::epsilon()) == fixed_t::epsilon(2) );
-	assert( fixed_t(2.0).times(fixed_t::epsilon(2)) == fixed_t::epsilon(4) );
-	assert( fixed_t::epsilon(1).times(fixed_t::epsilon(1)) == fixed_t(0) );
+	assert( F(1.0).times(F::epsilon()) == F::epsilon() );
+	assert( F(1.0).times(F::epsilon(2)) == F::epsilon(2) );
+	assert( F(2.0).times(F::epsilon()) == F::epsilon(2) );
+	assert( F(2.0).times(F::epsilon(2)) == F::epsilon(4) );
+	assert( F::epsilon(1).times(F::epsilon(1)) == F(0) );
 
 	//	Test saturation (max)
-	assert( fixed_t::nan().times(fixed_t(1, 0)).is_nan() );
-	assert( fixed_t::nan().times(fixed_t(0, 1)).is_nan() );
+	assert( F::nan().times(F(1, 0)).is_nan() );
+	assert( F::nan().times(F(0, 1)).is_nan() );
 }
 
+template <typename F>
 void test_plus()
 {
 	// Tests operator+
-	assert( fixed_t(1) + fixed_t(1) == fixed_t(2) );
-	assert( fixed_t(1) + fixed_t(2) == fixed_t(3) );
-	assert( fixed_t(1) + fixed_t(3) == fixed_t(4) );
-	assert( fixed_t(1) + fixed_t(4) == fixed_t(5) );
-	assert((fixed_t(1.5) + fixed_t(2.5)) == fixed_t(4.0));
-	assert((fixed_t(-1) + fixed_t(2)) == fixed_t(1));
-	assert((fixed_t(-3) + fixed_t(-2)) == fixed_t(-5));
-	assert((fixed_t(-3) + fixed_t(2)) == fixed_t(-1));
-	assert((fixed_t(-1.5) + fixed_t(2.5)) == fixed_t(1.0));
-	assert((fixed_t(0) + fixed_t(2)) == fixed_t(2));
+	assert( F(1) + F(1) == F(2) );
+	assert( F(1) + F(2) == F(3) );
+	assert( F(1) + F(3) == F(4) );
+	assert( F(1) + F(4) == F(5) );
+	assert((F(1.5) + F(2.5)) == F(4.0));
+	assert((F(-1) + F(2)) == F(1));
+	assert((F(-3) + F(-2)) == F(-5));
+	assert((F(-3) + F(2)) == F(-1));
+	assert((F(-1.5) + F(2.5)) == F(1.0));
+	assert((F(0) + F(2)) == F(2));
 
 	// Test commutativity of addition
-	assert((fixed_t(1) + fixed_t(2)) == (fixed_t(2) + fixed_t(1)));
-	assert((fixed_t(1.5) + fixed_t(2.5)) == (fixed_t(2.5) + fixed_t(1.5)));
-	assert((fixed_t(-1) + fixed_t(2)) == (fixed_t(2) + fixed_t(-1)));
-	assert((fixed_t(-1.5) + fixed_t(2.5)) == (fixed_t(2.5) + fixed_t(-1.5)));
-	assert((fixed_t(0) + fixed_t(2)) == (fixed_t(2) + fixed_t(0)));
+	assert((F(1) + F(2)) == (F(2) + F(1)));
+	assert((F(1.5) + F(2.5)) == (F(2.5) + F(1.5)));
+	assert((F(-1) + F(2)) == (F(2) + F(-1)));
+	assert((F(-1.5) + F(2.5)) == (F(2.5) + F(-1.5)));
+	assert((F(0) + F(2)) == (F(2) + F(0)));
 
 	//	Test saturation (max)
-	assert( (fixed_t::nan() + fixed_t(1)).is_nan() );
-	assert( (fixed_t::nan() + fixed_t::nan()).is_nan() );
-	assert( (fixed_t::nan() + fixed_t::epsilon()).is_nan() );
+	assert( (F::nan() + F(1)).is_nan() );
+	assert( (F::nan() + F::nan()).is_nan() );
+	assert( (F::nan() + F::epsilon()).is_nan() );
 
 	//	Test we get to saturation
-	assert( fixed_t(ISIZE_MAX) + fixed_t::epsilon() == fixed_t(ISIZE_MAX,1) );
-	assert( (fixed_t(ISIZE_MAX) + fixed_t(1)).is_nan() );
+	assert( F(F::ISIZE_MAX) + F::epsilon() == F(F::ISIZE_MAX,1) );
+	assert( (F(F::ISIZE_MAX) + F(1)).is_nan() );
 
 	//	Iterate from 0 to max by eplison steps
-	fixed_t f(0);
-	while (!f.is_nan())
+	if constexpr (F::ISIZE+F::FSIZE<=16)
 	{
-		f = f + fixed_t::epsilon();
+		F f(0);
+		while (!f.is_nan())
+		{
+			f = f + F::epsilon();
+		}
 	}
 }
 
-void check_mul2( fixed_t a, fixed_t b )
+template <typename F>
+void check_mul2( F a, F b )
 {
 	auto result = a.mul2(b);
-	fixed_t expected(a.to_float() * b.to_float() * 2);
 
-	if (fixed_t(2,211)<a || fixed_t(2,211)<b)
+	//	2ab rounded to the nearest epsilon, in integers (floats are too short for the large formats)
+	typedef typename F::wide_t wide_t;
+	wide_t m = ((wide_t)a.magnitude()*b.magnitude()*2 + (wide_t(1) << (F::FSIZE-1))) >> F::FSIZE;
+	F expected = m>F::MAGNITUDE_MAX ? F::nan() : F::from_magnitude( false, m );
+
+	if (a.squared().is_nan() || b.squared().is_nan())
 	{
-		expected = fixed_t::nan();
+		expected = F::nan();
 	}
 
-	if (fixed_t::epsilon(1)<(result-expected).abs())
+	//	Each of the 3 squares is truncated (like the ASM table), so we can be off by 2
+	if (F::epsilon(2)<(result-expected).abs())
 	{
 		std::cout << a << " * " << b << " = " << result << " != " << expected << std::endl;
 		std::cout << "    " << a.squared() << "+" << b.squared() << "-" << (a-b).squared() << " (" << a-b << ")" << std::endl;
 	}
 }
 
+template <typename F>
 void test_mul()
 {
 	//	Test mul2
-	assert( fixed_t(1).mul2(fixed_t(1)) == fixed_t(2) );
-	assert( fixed_t(1).mul2(fixed_t(2)) == fixed_t(4) );
-	assert( (fixed_t(1).mul2(fixed_t(3))).is_nan() );
-	assert( (fixed_t(2).mul2(fixed_t(2))).is_nan() );
-	assert( fixed_t(2).mul2(fixed_t(0.5)) == fixed_t(2) );
-	assert( fixed_t(2).mul2(fixed_t::epsilon()) == fixed_t(0, 4) );
-	assert( fixed_t(-2).mul2(fixed_t(0.5)) == fixed_t(-2) );
-	assert( fixed_t(2).mul2(fixed_t(-0.5)) == fixed_t(-2) );
-	assert( fixed_t(-2).mul2(fixed_t(-0.5)) == fixed_t(2) );
-
-// std::cout << fixed_t(0,1).squared() << std::endl;
-// std::cout << fixed_t(0,20).squared() << std::endl;
-// std::cout << fixed_t(0,1)-fixed_t(0,20) << std::endl;
-// std::cout << (fixed_t(0,1)-fixed_t(0,20)).squared() << std::endl;
-
-// 	assert( fixed_t(0,1) * fixed_t(0,20) == fixed_t(0) );
-
-	//	Iterate over all positive multiplication cases
-	fixed_t f(0);
+	assert( F(1).mul2(F(1)) == F(2) );
+	assert( F(1).mul2(F(2)) == F(4) );
+	assert( (F(1).mul2(F(F::ISIZE_MAX))).is_nan() );
+	if constexpr (F::ISIZE==3)
+	{
+		assert( (F(1).mul2(F(3))).is_nan() );
+		assert( (F(2).mul2(F(2))).is_nan() );
+	}
+	assert( F(2).mul2(F(0.5)) == F(2) );
+	assert( F(2).mul2(F::epsilon()) == F(0, 4) );
+	assert( F(-2).mul2(F(0.5)) == F(-2) );
+	assert( F(2).mul2(F(-0.5)) == F(-2) );
+	assert( F(-2).mul2(F(-0.5)) == F(2) );
+
+// std::cout << F(0,1).squared() << std::endl;
+// std::cout << F(0,20).squared() << std::endl;
+// std::cout << F(0,1)-F(0,20) << std::endl;
+// std::cout << (F(0,1)-F(0,20)).squared() << std::endl;
+
+// 	assert( F(0,1) * F(0,20) == F(0) );
+
+	//	Iterate over all positive multiplication cases (or 512 of them per operand past 11 bits)
+	auto step = F::epsilon( F::ISIZE+F::FSIZE<=11 ? 1 : (typename F::wide_t)F::MAGNITUDE_MAX >> 9 );
+	F f(0);
 	while (!f.is_nan())
 	{
-		fixed_t g(0);
+		F g(0);
 		while (!g.is_nan())
 		{
 			check_mul2(f, g);
-			g = g + fixed_t::epsilon();
+			g = g + step;
 		}
-		f = f + fixed_t::epsilon();
+		f = f + step;
 	}
 }
 
 // Tests for the fixed point class
+template <typename F>
 void test_fixed()
 {
-	test_creation();
-	test_times();
-	test_plus();
-	test_mul();
+	test_creation<F>();
+	test_times<F>();
+	test_plus<F>();
+	test_mul<F>();
+}
+
+//	Checks that packed_t computes exactly what fixed_t computes
+void test_packed()
+{
+	//	Layout
+	assert( packed_t(fixed_t(1.0)).get() == 0x0200 );
+	assert( packed_t(fixed_t(-1.0)).get() == (int16_t)0xFE00 );
+	assert( packed_t::epsilon().get() == 0x0002 );
+	assert( packed_t::nan().get() == 0x0001 );
+	assert( packed_t(fixed_t(-2.093)).as_asm() == fixed_t(-2.093).as_asm() );
+
+	//	All representable numbers
+	for (int a=-PACKED_MAX;a<=PACKED_MAX;a+=2)
+	{
+		packed_t pa = packed_t::raw(a);
+		fixed_t fa = pa;
+		assert( packed_t(fa).get() == a );
+		assert( packed_t(fa.squared()).get() == pa.squared().get() );
+		assert( packed_t(-fa).get() == (-pa).get() );
+		if (a>=0)
+			assert( packed_t(fa.div2()).get() == pa.div2().get() );
+
+		//	Additions and multiplications with a sample of other numbers
+		for (int b=-PACKED_MAX;b<=PACKED_MAX;b+=2*7)
+		{
+			packed_t pb = packed_t::raw(b);
+			fixed_t fb = pb;
+			assert( packed_t(fa+fb).get() == (pa+pb).get() );
+			assert( packed_t(fa-fb).get() == (pa-pb).get() );
+			assert( packed_t(fa.mul2(fb)).get() == pa.mul2(pb).get() );
+		}
+	}
+
+	//	NaN propagation
+	assert( (packed_t::nan() + packed_t(1.0f)).is_nan() );
+	assert( (packed_t(1.0f) + packed_t::nan()).is_nan() );
+	assert( packed_t::nan().squared().is_nan() );
+	assert( (packed_t(7.0f) + packed_t(1.0f)).is_nan() );
+	assert( (packed_t(-7.0f) + packed_t(-1.0f)).is_nan() );
 }
 
 class ioutput
@@ -477,12 +930,18 @@ class ioutput
 protected:
 	int w_;
 	int h_;
+#ifdef STATS
+	std::string description_;
+#endif
 public:
 	virtual ~ioutput() {}
 	void output_start( const std::string s, int w, int h )
 	{
 		w_ = w;
 		h_ = h;
+#ifdef STATS
+		description_ = s;
+#endif
 		do_output_start( s );
 	}
 	virtual void do_output_start( const std::string s ) {}
@@ -497,6 +956,7 @@ public:
 	void output_end()
 	{
 		do_output_end();
+		STATS_DUMP( description_ );
 	}
 
 	virtual void do_output_end() {}
@@ -558,6 +1018,19 @@ class font_t
 	int i1_[64];
 	int i2_[64];
 	int i3_[64];
+
+	//	Intensity of each 2x2 block, line by line (for 4x4 sub-samples)
+	int blocks_[64][16];
+
+	//	Best character for every quantized quad, and quantized level of every count
+	static const int LEVELS = 17;
+	std::vector<uint8_t> best_;
+	uint8_t level_[256];
+
+	static int index( int i0, int i1, int i2, int i3 )
+	{
+		return ((i0*LEVELS+i1)*LEVELS+i2)*LEVELS+i3;
+	}
 public:
 	font_t( const char *name )
 	{
@@ -577,6 +1050,12 @@ public:
 
 		for (int i=0;i!=64;i++)
 			i0_[i] = i1_[i] = i2_[i] = i3_[i] = 0;
+		memset( blocks_, 0, sizeof(blocks_) );
+
+		for (int i=0;i!=64;i++)
+			for (int line=0;line!=8;line++)
+				for (int j=0;j!=8;j++)
+					blocks_[i][line/2*4+j/2] += (font_[i*8+line]>>j)&1;
 
 		for (int i=0;i!=64;i++)
 		{
@@ -609,6 +1088,15 @@ public:
 				}
 			}
 		}
+
+		for (int i=0;i!=256;i++)
+			level_[i] = level( i );
+		best_.resize( LEVELS*LEVELS*LEVELS*LEVELS );
+		for (int i0=0;i0!=LEVELS;i0++)
+			for (int i1=0;i1!=LEVELS;i1++)
+				for (int i2=0;i2!=LEVELS;i2++)
+					for (int i3=0;i3!=LEVELS;i3++)
+						best_[index( i0, i1, i2, i3 )] = scan( i0, i1, i2, i3 );
 	}
 
 	const uint8_t *get( int c ) const
@@ -627,23 +1115,18 @@ public:
 		return d0+d1+d2+d3;
 	}
 
-	const u_int8_t best( int i0, int i1, int i2, int i3 ) const
+	//	Quantized intensity of an iteration count, in [0,LEVELS[
+	static int level( int i )
+	{
+		i = std::max( i, 4 )-4;
+		i /= 4;
+		if (i>16) i = 16;
+		return i;
+	}
+
+	//	Linear search of the best character match for quantized intensities
+	int scan( int i0, int i1, int i2, int i3 ) const
 	{
-		i0 = std::max( i0, 4 )-4;
-		i1 = std::max( i1, 4 )-4;
-		i2 = std::max( i2, 4 )-4;
-		i3 = std::max( i3, 4 )-4;
-
-		i0 /= 4;
-		i1 /= 4;
-		i2 /= 4;
-		i3 /= 4;
-		if (i0>16) i0 = 16;
-		if (i1>16) i1 = 16;
-		if (i2>16) i2 = 16;
-		if (i3>16) i3 = 16;
-
-		// Find best character match
 		int best = 0;
 		int best_dist = dist(0, i0, i1, i2, i3);
 		for (int i=1;i!=size;i++)
@@ -658,32 +1141,95 @@ public:
 
 		return best;
 	}
+
+	const u_int8_t best( int i0, int i1, int i2, int i3 ) const
+	{
+		return best_[index( level( i0 ), level( i1 ), level( i2 ), level( i3 ) )];
+	}
+
+	//	Best character for 4x4 iteration counts, line by line
+	//	Each count is matched against a 2x2 block, so its level is compared to 4 times the block
+	uint8_t best16( const uint8_t *its ) const
+	{
+		//	Same character as best() when each quadrant has a single level
+		int quads[4];
+		bool uniform = true;
+		for (int q=0;q!=4;q++)
+		{
+			const uint8_t *it = its+q/2*8+q%2*2;
+			quads[q] = level_[it[0]];
+			uniform &= level_[it[1]]==quads[q] && level_[it[4]]==quads[q] && level_[it[5]]==quads[q];
+		}
+		if (uniform)
+			return best_[index( quads[0], quads[1], quads[2], quads[3] )];
+
+		int best = 0;
+		int best_dist = INT32_MAX;
+		for (int c=0;c!=size;c++)
+		{
+			int d = 0;
+			for (int k=0;k!=16;k++)
+				d += std::abs( 4*blocks_[c][k]-level_[its[k]] );
+			if (d<best_dist)
+			{
+				best = c;
+				best_dist = d;
+			}
+		}
+		return best;
+	}
+
+	//	best() of n quads of iteration counts
+	void best_row( const uint8_t *i0, const uint8_t *i1, const uint8_t *i2, const uint8_t *i3, int n, char *chars ) const
+	{
+		for (int k=0;k!=n;k++)
+			chars[k] = best_[index( level_[i0[k]], level_[i1[k]], level_[i2[k]], level_[i3[k]] )];
+	}
 };
 
 class img_output : public ioutput
 {
 	const font_t &font_;
 
-	uint8_t *data;
-	// [40*24*8];
+	//	One band of 8 scanlines, written as soon as its last character is drawn
+	//	Reused from one image to the next
+	std::vector<uint8_t> band_;
+	std::ofstream ofs_;
+	std::string filename_;
 
 	int x_ = 0;
 	int y_ = 0;
 
 	int index_ = 0;
+
+	//	Cycles spent on each character, written as a PGM next to the next PBM
+	std::vector<uint64_t> heat_;
 public:
 	img_output( const font_t &font ) : font_(font) {}
 
+	void set_heatmap( const std::vector<uint64_t> &heat )
+	{
+		heat_ = heat;
+	}
+
 	virtual void do_output_start( const std::string s )
 	{
 		x_ = y_ = 0;
-		data = new uint8_t[w_*h_*8];
+		band_.resize( w_*8 );
+
+		filename_ = "/tmp/mandel";
+		filename_ += std::to_string(index_++);
+		filename_ += ".pbm";
+		// Write data as a w*8 x h*8 black and white pixel image
+		ofs_.open(filename_, std::ios::binary);
+		if (!ofs_)
+			std::cerr << "Cannot open file " << filename_ << std::endl;
+		ofs_ << "P4" << std::endl;
+		ofs_ << w_*8 << " " << h_*8 << std::endl;
 	}
 
 	virtual void do_output( char c, fixed_t fx, fixed_t fy )
 	{
-		int offset = y_*w_*8+x_;
-
 		if ((y_%24)==0)
 		{
 			std::string s = std::to_string( fx.to_float() )+","+std::to_string( fy.to_float() );
@@ -694,46 +1240,60 @@ public:
 
 		auto p = font_.get(c);
 		for (int i=0;i!=8;i++)
-		{
-			assert( offset+i*w_ >= 0 );
-			assert( offset+i*w_ < w_*h_*8 );
-			data[offset+i*w_] = p[i];
-		}
+			band_[i*w_+x_] = p[i];
 
 		x_++;
 		if (x_==w_)
 		{
+			write_band();
 			x_ = 0;
 			y_++;
 		}
 	}
 
+	//	Inverts the band (and the lines between 40x24 screens) and writes it
+	void write_band()
+	{
+		for (int i = 0; i < 8; i++)
+		{
+			uint8_t *line = &band_[i*w_];
+			uint8_t mask = ((y_*8+i)%(24*8))==0 ? 0x00 : 0xff;
+			for (int j = 0; j < w_; j++)
+				line[j] ^= mask;
+			for (int j = 0; j < w_; j += 40)
+				line[j] ^= 0x80;
+		}
+		ofs_.write( (const char *)band_.data(), band_.size() );
+	}
+
 	virtual void do_output_end()
 	{
-		std::string filename = "/tmp/mandel";
-		filename += std::to_string(index_++);
-		filename += ".pbm";
-		// Write data as a 320x192 black and white pixel image
+		ofs_.close();
+
+		if (heat_.size()==w_*h_)
+			write_heatmap( filename_.substr( 0, filename_.size()-4 )+".pgm" );
+	}
+
+	//	Each character is a 8x8 block, the slowest one is white
+	void write_heatmap( const std::string &filename )
+	{
 		std::ofstream ofs(filename, std::ios::binary);
 		if (!ofs) {
 			std::cerr << "Cannot open file " << filename << std::endl;
 			return;
 		}
-		ofs << "P4" << std::endl;
+		uint64_t max = std::max<uint64_t>( 1, *std::max_element( heat_.begin(), heat_.end() ) );
+		ofs << "P5" << std::endl;
 		ofs << w_*8 << " " << h_*8 << std::endl;
+		ofs << 255 << std::endl;
+		std::vector<uint8_t> line( w_*8 );
 		for (int i = 0; i < h_*8; i++)
 		{
-			for (int j = 0; j < w_; j++)
-			{
-				auto v = (uint8_t)((data[i * w_ + j]^0xff));
-				if ((i%(24*8))==0)
-					v ^= 0xff;
-				if ((j%40)==0)
-					v ^= 0x80;
-				ofs << v;
-			}
+			for (int j = 0; j < w_*8; j++)
+				line[j] = heat_[(i/8)*w_+j/8]*255/max;
+			ofs.write( (const char *)line.data(), line.size() );
 		}
-		ofs.close();
+		heat_.clear();
 	}
 };
 
@@ -762,108 +1322,5064 @@ struct place_t
 	}
 };
 
-int iter( fixed_t x, fixed_t y, fixed_t zx, fixed_t zy )
+const int ITER_MAX=250;
+
+//	T is either fixed_t or packed_t (same results, packed_t is faster)
+//	With periodicity, the state is saved at iterations 0, 1, 3, 7... (Brent) and
+//	finding it again means a cycle that never escapes, so ITER_MAX is returned at once
+//	(the renders have no zoom level, so the cap is always ITER_MAX: only the ASM
+//	model, iter_asm, is specialised on the MAXITER of each level)
+template <typename T>
+int iter( T x, T y, T zx, T zy, bool periodicity=true )
 {
-	fixed_t zx2 = zx.squared();
-	fixed_t zy2 = zy.squared();
+	T zx2 = zx.squared();
+	T zy2 = zy.squared();
+	T sx = zx;
+	T sy = zy;
+	int save_at = 0;
 	int i = 0;
-	while (i < 250 && !(zx2 + zy2).is_nan())
+	while (i < ITER_MAX && !(zx2 + zy2).is_nan())
 	{
-		zy = zx.mul2(zy) + y;
+		if (periodicity)
+		{
+			if (i==save_at)
+			{
+				sx = zx;
+				sy = zy;
+				save_at = 2*save_at+1;
+			}
+			else if (zx==sx && zy==sy)
+			{
+				STATS_ITER( i, ITER_MAX, false, zx, zy, zx2, zy2 );
+				return ITER_MAX;
+			}
+		}
+
+		zy = zx.mul2(zy) + y;
 		zx = zx2 - zy2 + x;
 		zx2 = zx.squared();
 		zy2 = zy.squared();
 		i++;
 	}
-	return i;
+	STATS_ITER( i, i, i<ITER_MAX, zx, zy, zx2, zy2 );
+	return i;
+}
+
+//	SIMD version of iter<packed_t>, on BYTES/4 points at once
+//	Each lane holds a packed_t in 32 bits, with a separate NaN mask
+template <int BYTES> struct vint_traits;
+template <> struct vint_traits<16> { typedef int32_t type __attribute__((vector_size(16))); };
+template <> struct vint_traits<32> { typedef int32_t type __attribute__((vector_size(32))); };
+template <> struct vint_traits<64> { typedef int32_t type __attribute__((vector_size(64))); };
+
+template <int BYTES>
+struct vkernel_t
+{
+	typedef typename vint_traits<BYTES>::type vint_t;
+	static const int LANES = BYTES/sizeof(int32_t);
+
+	//	NaN mask is -1 for NaN, and the value is then forced to 0
+	struct vpacked_t
+	{
+		vint_t v_;
+		vint_t nan_;
+	};
+
+	#define VINLINE static inline __attribute__((always_inline))
+
+	VINLINE vpacked_t make( const vint_t &v, const vint_t &nan )
+	{
+		return { v & ~nan, nan };
+	}
+
+	VINLINE vpacked_t load( const vint_t &v )
+	{
+		return make( v, -(v & 1) );
+	}
+
+	VINLINE vpacked_t add( const vpacked_t &a, const vpacked_t &b )
+	{
+		vint_t s = a.v_ + b.v_;
+		return make( s, a.nan_ | b.nan_ | (s > PACKED_MAX) | (s < -PACKED_MAX) );
+	}
+
+	VINLINE vpacked_t neg( const vpacked_t &a )
+	{
+		return { -a.v_, a.nan_ };
+	}
+
+	//	Closed form of the square table: truncated square, NaN from 8
+	VINLINE vpacked_t squared( const vpacked_t &a )
+	{
+		vint_t m = (a.v_ < 0 ? -a.v_ : a.v_) >> 1;
+		vint_t sq = (m*m) >> FSIZE;
+		return make( sq << 1, a.nan_ | (sq > (PACKED_MAX >> 1)) );
+	}
+
+	VINLINE vpacked_t mul2( const vpacked_t &x, const vpacked_t &y )
+	{
+		auto xmy2 = squared( add( x, neg( y ) ) );
+		return add( add( neg( xmy2 ), squared( x ) ), squared( y ) );
+	}
+
+	VINLINE void iter_row( const packed_t *x, const packed_t *y, const packed_t *zx, const packed_t *zy, int n, uint8_t *its )
+	{
+		for (int k=0;k<n;k+=LANES)
+		{
+			vint_t lx, ly, lzx, lzy;
+			for (int l=0;l!=LANES;l++)
+			{
+				//	Extra lanes redo the last point
+				int p = std::min( k+l, n-1 );
+				lx[l] = x[p].get();
+				ly[l] = y[p].get();
+				lzx[l] = zx[p].get();
+				lzy[l] = zy[p].get();
+			}
+			vpacked_t vx = load( lx );
+			vpacked_t vy = load( ly );
+			vpacked_t vzx = load( lzx );
+			vpacked_t vzy = load( lzy );
+
+			vpacked_t vzx2 = squared( vzx );
+			vpacked_t vzy2 = squared( vzy );
+			vint_t it = {};
+			vint_t active = ~add( vzx2, vzy2 ).nan_;
+
+			//	Periodicity check, as in iter()
+			vint_t sx = {}, sy = {};
+			int save_at = 0;
+
+			for (int i=0;i!=ITER_MAX;i++)
+			{
+				bool any = false;
+				for (int l=0;l!=LANES;l++)
+					any |= active[l]!=0;
+				if (!any)
+					break;
+
+				if (i==save_at)
+				{
+					sx = vzx.v_;
+					sy = vzy.v_;
+					save_at = 2*save_at+1;
+				}
+				else
+				{
+					vint_t cycle = active & (vzx.v_==sx) & (vzy.v_==sy);
+					it = (it & ~cycle) | (ITER_MAX & cycle);
+					active &= ~cycle;
+				}
+
+				vzy = add( mul2( vzx, vzy ), vy );
+				vzx = add( add( vzx2, neg( vzy2 ) ), vx );
+				vzx2 = squared( vzx );
+				vzy2 = squared( vzy );
+				it -= active;
+				active &= ~add( vzx2, vzy2 ).nan_;
+			}
+
+			for (int l=0;l!=LANES && k+l<n;l++)
+				its[k+l] = it[l];
+		}
+	}
+
+	#undef VINLINE
+};
+
+//	One version per instruction set, the best one is picked on first call
+//	GCC only generates good code for generic vectors that match the register size
+//	of the function target, and cannot do it for AVX-512 through the target attribute,
+//	so the 16 lanes version is only used when compiling with AVX-512 (-march=native)
+#ifdef __AVX512F__
+void iter_row_avx512( const packed_t *x, const packed_t *y, const packed_t *zx, const packed_t *zy, int n, uint8_t *its )
+{
+	vkernel_t<64>::iter_row( x, y, zx, zy, n, its );
+}
+#endif
+
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(__clang__)
+#define SIMD_DISPATCH
+__attribute__((target("avx2")))
+void iter_row_avx2( const packed_t *x, const packed_t *y, const packed_t *zx, const packed_t *zy, int n, uint8_t *its )
+{
+	vkernel_t<32>::iter_row( x, y, zx, zy, n, its );
+}
+#endif
+
+void iter_row_sse2( const packed_t *x, const packed_t *y, const packed_t *zx, const packed_t *zy, int n, uint8_t *its )
+{
+	vkernel_t<16>::iter_row( x, y, zx, zy, n, its );
+}
+
+//	Iterates n points, stores the iteration counts in its
+//	Same results as iter<packed_t>
+void iter_row( const packed_t *x, const packed_t *y, const packed_t *zx, const packed_t *zy, int n, uint8_t *its )
+{
+	typedef void (*kernel_t)( const packed_t *, const packed_t *, const packed_t *, const packed_t *, int, uint8_t * );
+	static const kernel_t kernel = []() -> kernel_t
+	{
+#ifdef __AVX512F__
+		return iter_row_avx512;
+#endif
+#ifdef SIMD_DISPATCH
+		if (__builtin_cpu_supports( "avx2" ))
+			return iter_row_avx2;
+#endif
+		return iter_row_sse2;
+	}();
+	kernel( x, y, zx, zy, n, its );
+}
+
+//	Checks the square table against the exact squares
+void test_squaretable()
+{
+	for (int n=0;n!=SQUARETABLE_SIZE;n++)
+	{
+		int sq = n*n;
+		if (sq >= 8 << (2*FSIZE))
+			assert( squaretable[n] == 0x0001 );
+		else
+			assert( squaretable[n] == (sq >> FSIZE) << 1 );
+		assert( packed_t::epsilon(n).squared().get() == (int16_t)squaretable[n] );
+		assert( packed_t::epsilon(-n).squared().get() == (int16_t)squaretable[n] );
+	}
+}
+
+//	Checks that fixed_t and packed_t give the same iteration counts
+void test_iter()
+{
+	for (int y=-384;y<=384;y+=17)
+		for (int x=-640;x<=256;x+=13)
+		{
+			fixed_t fx = packed_t::epsilon(x);
+			fixed_t fy = packed_t::epsilon(y);
+			assert( iter(fx,fy,fx,fy) == iter<packed_t>(fx,fy,fx,fy) );
+			assert( iter(fy,fx,fx,fy) == iter<packed_t>(fy,fx,fx,fy) );
+			assert( iter(fx,fy,fx,fy) == iter(fx,fy,fx,fy,false) );
+			assert( iter<packed_t>(fy,fx,fx,fy) == iter<packed_t>(fy,fx,fx,fy,false) );
+		}
+}
+
+//	Checks iter on the other formats, with and without periodicity check
+template <typename F>
+void test_iter_format()
+{
+	typedef typename F::real_t real_t;
+	for (int y=-24;y<=24;y+=4)
+		for (int x=-40;x<=16;x+=4)
+		{
+			F fx = real_t( x/16.0 );
+			F fy = real_t( y/16.0+1/1024.0 );
+			assert( iter(fx,fy,fx,fy) == iter(fx,fy,fx,fy,false) );
+			assert( iter(fy,fx,fx,fy) == iter(fy,fx,fx,fy,false) );
+		}
+}
+
+//	Checks the SIMD kernel against iter<packed_t>, including NaN and out of range points
+void test_iter_row()
+{
+	std::vector<packed_t> xs, ys, cx, cy;
+	for (int y=-PACKED_MAX-2;y<=PACKED_MAX;y+=2*11)
+		for (int x=-PACKED_MAX;x<=PACKED_MAX+2;x+=2*7)
+		{
+			xs.push_back( x>PACKED_MAX ? packed_t::nan() : packed_t::raw(x) );
+			ys.push_back( y<-PACKED_MAX ? packed_t::nan() : packed_t::raw(y) );
+			cx.push_back( packed_t(-0.8f) );
+			cy.push_back( packed_t(0.156f) );
+		}
+	int n = xs.size();
+	std::vector<uint8_t> its(n);
+
+	std::vector<decltype(&iter_row)> kernels = { iter_row, iter_row_sse2 };
+#ifdef SIMD_DISPATCH
+	if (__builtin_cpu_supports( "avx2" ))
+		kernels.push_back( iter_row_avx2 );
+#endif
+
+	for (auto kernel:kernels)
+	{
+		kernel( xs.data(), ys.data(), xs.data(), ys.data(), n, its.data() );
+		for (int k=0;k!=n;k++)
+			assert( its[k] == iter( xs[k], ys[k], xs[k], ys[k] ) );
+
+		kernel( cx.data(), cy.data(), xs.data(), ys.data(), n-3, its.data() );
+		for (int k=0;k!=n-3;k++)
+			assert( its[k] == iter( cx[k], cy[k], xs[k], ys[k] ) );
+	}
+}
+
+//	The character of each iteration count, as a table built at compile time
+constexpr std::array<char,256> palette_table = []()
+{
+	constexpr char p[] = " .,'~=+:;[/<*?&o0x#";
+	std::array<char,256> t {};
+	for (int it=0;it!=256;it++)
+	{
+		int i = it/2;
+		if (i<3)
+			t[it] = ' ';
+		else if (i-3>=(int)sizeof(p)-1)
+			t[it] = '#';
+		else
+			t[it] = p[i-3];
+	}
+	return t;
+}();
+
+inline char palette( int i )
+{
+	return palette_table[i];
+}
+
+//	An iteration count to character table of 64 entries, padded with its last
+//	character: counts are clamped to 63, and a row of counts can be converted with
+//	byte shuffles
+struct palette_lut_t
+{
+	std::array<uint8_t,64> chars_ {};
+	int size_ = 0;		//	Entries before the padding
+
+	constexpr palette_lut_t( const char *p, int size ) : size_(size)
+	{
+		for (int it=0;it!=64;it++)
+			chars_[it] = p[std::min( it, size-1 )];
+	}
+
+	char operator[]( int it ) const
+	{
+		return chars_[std::min( it, 63 )];
+	}
+};
+
+//	palette_table is constant past 63
+constexpr palette_lut_t palette_lut( palette_table.data(), 64 );
+static_assert( palette_table[63]=='#' && palette_table[255]=='#' );
+
+void palette_row_scalar( const palette_lut_t &lut, const uint8_t *its, int n, char *chars )
+{
+	for (int k=0;k!=n;k++)
+		chars[k] = lut[its[k]];
+}
+
+typedef uint8_t vbytes16_t __attribute__((vector_size(16)));
+typedef uint8_t vbytes64_t __attribute__((vector_size(64)));
+
+//	One AVX-512 VBMI byte permute per 64 counts (only with -march=native)
+#ifdef __AVX512VBMI__
+void palette_row_avx512( const palette_lut_t &lut, const uint8_t *its, int n, char *chars )
+{
+	vbytes64_t table;
+	memcpy( &table, lut.chars_.data(), 64 );
+	int k = 0;
+	for (;k+64<=n;k+=64)
+	{
+		vbytes64_t it;
+		memcpy( &it, its+k, 64 );
+		it = it<63 ? it : 63;
+		vbytes64_t c = __builtin_shuffle( table, it );
+		memcpy( chars+k, &c, 64 );
+	}
+	palette_row_scalar( lut, its+k, n-k, chars+k );
+}
+#endif
+
+//	One pshufb per 16 entries of the table, selected by the high bits of the counts
+//	(the shuffle indexes are taken modulo 16)
+#ifdef SIMD_DISPATCH
+__attribute__((target("ssse3")))
+void palette_row_ssse3( const palette_lut_t &lut, const uint8_t *its, int n, char *chars )
+{
+	vbytes16_t parts[4];
+	memcpy( parts, lut.chars_.data(), 64 );
+	int k = 0;
+	for (;k+16<=n;k+=16)
+	{
+		vbytes16_t it;
+		memcpy( &it, its+k, 16 );
+		it = it<63 ? it : 63;
+		vbytes16_t high = it>>4;
+		vbytes16_t c = __builtin_shuffle( parts[0], it );
+		for (int p=1;p!=4;p++)
+			c = high==(uint8_t)p ? __builtin_shuffle( parts[p], it ) : c;
+		memcpy( chars+k, &c, 16 );
+	}
+	palette_row_scalar( lut, its+k, n-k, chars+k );
+}
+#endif
+
+//	The characters of n iteration counts, as lut[its[k]]
+void palette_row( const palette_lut_t &lut, const uint8_t *its, int n, char *chars )
+{
+	typedef void (*kernel_t)( const palette_lut_t &, const uint8_t *, int, char * );
+	static const kernel_t kernel = []() -> kernel_t
+	{
+#ifdef __AVX512VBMI__
+		return palette_row_avx512;
+#endif
+#ifdef SIMD_DISPATCH
+		if (__builtin_cpu_supports( "ssse3" ))
+			return palette_row_ssse3;
+#endif
+		return palette_row_scalar;
+	}();
+	kernel( lut, its, n, chars );
+}
+
+//	Checks the row conversion against palette(), on every count and row length
+void test_palette_row()
+{
+	std::vector<uint8_t> its( 256+67 );
+	for (int k=0;k!=its.size();k++)
+		its[k] = k*37+k/256;
+	for (int it=0;it!=256;it++)
+		assert( palette_lut[it]==palette( it ) );
+
+	std::vector<void (*)( const palette_lut_t &, const uint8_t *, int, char * )> kernels = { palette_row_scalar, palette_row };
+#ifdef SIMD_DISPATCH
+	if (__builtin_cpu_supports( "ssse3" ))
+		kernels.push_back( palette_row_ssse3 );
+#endif
+	for (auto kernel:kernels)
+		for (int n=0;n<=67;n++)
+		{
+			std::vector<char> chars( 256+n, 0 );
+			kernel( palette_lut, its.data()+n, 256, chars.data() );
+			kernel( palette_lut, its.data(), n, chars.data()+256 );
+			for (int k=0;k!=256;k++)
+				assert( chars[k]==palette( its[k+n] ) );
+			for (int k=0;k!=n;k++)
+				assert( chars[256+k]==palette( its[k] ) );
+		}
+}
+
+template <typename T=fixed_t>
+void mandel( const place_t &place, ioutput &out )
+{
+	std::cout << place.description() << "\n";
+	out.output_start( place.description(), place.w_, place.h_ );
+	const T rx = place.rx_;
+	const T ry = place.ry_;
+	T y = place.y_;
+	for (int i=0;i!=place.h_;i++)
+	{
+		STATS_ROW_START;
+		T x = place.x_;
+		for (int j=0;j!=place.w_;j++)
+		{
+			int it = iter(x,y,x,y);
+			out.output( palette(it), x, y );
+			x = x + rx;
+		}
+		y = y + ry;
+		STATS_ROW_END( i );
+		std::cout << i << " " << std::flush;
+	}
+	out.output_end();
+	std::cout << std::endl;
+}
+
+template <typename T=fixed_t>
+void mandelhr( const place_t &place, ioutput &out, const font_t &font )
+{
+	const T rx = place.rx_;
+	const T ry = place.ry_;
+	const T rxhr = place.rx_.div2();
+	const T ryhr = place.ry_.div2();
+
+	out.output_start( place.description(), place.w_, place.h_ );
+	T y = place.y_;
+	for (int i=0;i!=place.h_;i++)
+	{
+		STATS_ROW_START;
+		T x = place.x_;
+		for (int j=0;j!=place.w_;j++)
+		{
+			auto x0 = x;
+			auto y0 = y;
+			auto x1 = x + rxhr;
+			auto y1 = y + ryhr;
+
+			int it0 = iter(x0,y0,x0,y0);
+			int it1 = iter(x1,y0,x0,y1);
+			int it2 = iter(x0,y1,x1,y0);
+			int it3 = iter(x1,y1,x1,y1);
+
+			out.output( font.best( it0, it1, it2, it3 ), x, y );		
+
+			x = x + rx;
+		}
+		y = y + ry;
+		STATS_ROW_END( i );
+		std::cout << i << " " << std::flush;
+	}
+	out.output_end();
+	std::cout << std::endl;
+}
+
+
+template <typename T=fixed_t>
+void julia( const place_t &place, fixed_t cx, fixed_t cy, ioutput &out )
+{
+	out.output_start( place.description(), place.w_, place.h_ );
+	const T tcx = cx;
+	const T tcy = cy;
+	const T rx = place.rx_;
+	const T ry = place.ry_;
+	T y = place.y_;
+	for (int i=0;i!=place.h_;i++)
+	{
+		STATS_ROW_START;
+		T x = place.x_;
+		for (int j=0;j!=place.w_;j++)
+		{
+			int it = iter(tcx,tcy,x,y);
+			out.output( palette(it), x, y );
+			x = x + rx;
+		}
+		y = y + ry;
+		STATS_ROW_END( i );
+		std::cout << i << " " << std::flush;
+	}
+	out.output_end();
+	std::cout << std::endl;
+}
+
+//	Pins the calling thread on a cpu
+bool pin_thread( int cpu )
+{
+#ifdef __linux__
+	cpu_set_t set;
+	CPU_ZERO( &set );
+	CPU_SET( cpu, &set );
+	return cpu>=0 && sched_setaffinity( 0, sizeof(set), &set )==0;
+#else
+	return false;
+#endif
+}
+
+//	Runs jobs on all cores
+//	Each thread gets a contiguous range of tiles, and steals from the others when done
+class tile_pool_t
+{
+	int threads_;
+	std::vector<int> cpus_;		//	If set, worker w is pinned on cpus_[w]
+
+	struct queue_t
+	{
+		std::mutex mutex_;
+		std::deque<int> tiles_;
+	};
+
+	static bool pop_back( queue_t &q, int &tile )
+	{
+		std::lock_guard<std::mutex> lock(q.mutex_);
+		if (q.tiles_.empty())
+			return false;
+		tile = q.tiles_.back();
+		q.tiles_.pop_back();
+		return true;
+	}
+
+	static bool pop_front( queue_t &q, int &tile )
+	{
+		std::lock_guard<std::mutex> lock(q.mutex_);
+		if (q.tiles_.empty())
+			return false;
+		tile = q.tiles_.front();
+		q.tiles_.pop_front();
+		return true;
+	}
+
+public:
+	tile_pool_t( int threads=0 ) : threads_(threads)
+	{
+		if (threads_<=0)
+			threads_ = std::max( 1u, std::thread::hardware_concurrency() );
+	}
+
+	//	One thread per cpu, each pinned on its own
+	tile_pool_t( const std::vector<int> &cpus ) : threads_(std::max<int>( 1, cpus.size() )), cpus_(cpus) {}
+
+	int threads() const { return threads_; }
+
+	//	Calls job(tile) for each tile in [0,count[ and returns when all are done
+	template <typename F>
+	void run( int count, F job ) const
+	{
+		int n = std::min( threads_, count );
+		if (n<=1)
+		{
+			for (int t=0;t!=count;t++)
+				job( t );
+			return;
+		}
+
+		std::vector<queue_t> queues(n);
+		for (int t=0;t!=count;t++)
+			queues[(int64_t)t*n/count].tiles_.push_back( t );
+
+		std::vector<std::thread> workers;
+		for (int w=0;w!=n;w++)
+			workers.emplace_back( [&,w]()
+			{
+				if (!cpus_.empty())
+					pin_thread( cpus_[w] );
+				int tile;
+				for (;;)
+				{
+					if (!pop_back( queues[w], tile ))
+					{
+						bool stolen = false;
+						for (int v=1;v!=n && !stolen;v++)
+							stolen = pop_front( queues[(w+v)%n], tile );
+						if (!stolen)
+							return;
+					}
+					job( tile );
+				}
+			} );
+		for (auto &w:workers)
+			w.join();
+	}
+};
+
+const tile_pool_t tile_pool;
+
+const int TILE_W=32;
+const int TILE_H=8;
+
+//	Calls fn(k,i,j0,j1) for every tile row of count w x h grids, tile by tile, all
+//	on the same pool run (k is the grid, i the line, [j0,j1[ the columns)
+template <typename F>
+void render_batch_tiles( int count, int w, int h, F fn, const tile_pool_t &pool=tile_pool )
+{
+	int tw = (w+TILE_W-1)/TILE_W;
+	int th = (h+TILE_H-1)/TILE_H;
+	pool.run( count*tw*th, [&]( int job )
+	{
+		int k = job/(tw*th);
+		int tile = job%(tw*th);
+		int i0 = tile/tw*TILE_H;
+		int j0 = tile%tw*TILE_W;
+		int i1 = std::min( i0+TILE_H, h );
+		int j1 = std::min( j0+TILE_W, w );
+		for (int i=i0;i!=i1;i++)
+		{
+			STATS_ROW_START;
+			fn( k, i, j0, j1 );
+			STATS_ROW_END( i );
+		}
+	} );
+}
+
+//	Calls fn(i,j0,j1) for every tile row of a w x h grid, tile by tile, on the pool
+//	(i is the line, [j0,j1[ the columns)
+template <typename F>
+void render_tiles( int w, int h, F fn, const tile_pool_t &pool=tile_pool )
+{
+	render_batch_tiles( 1, w, h, [&]( int, int i, int j0, int j1 ) { fn( i, j0, j1 ); }, pool );
+}
+
+//	A file mapped in memory: a 16 bytes header then size bytes of data
+//	The header holds 8 bytes of magic, the version of what the data means (see
+//	iter_semantics) and a flag set by set_complete once all the data is written
+//	A file with another size, magic or version is reset to zeros
+class mapped_file_t
+{
+	struct header_t
+	{
+		char magic_[8];
+		uint32_t version_;
+		uint32_t complete_;
+	};
+	static const int HEADER=sizeof(header_t);
+	static_assert( HEADER==16 );
+
+	void *map_ = MAP_FAILED;
+	size_t size_ = 0;
+	bool fresh_ = false;
+
+	header_t *header() const { return (header_t *)map_; }
+
+public:
+	mapped_file_t( const char *filename, const char magic[8], uint32_t version, size_t size ) : size_(HEADER+size)
+	{
+		int fd = open( filename, O_RDWR | O_CREAT, 0644 );
+		struct stat st;
+		if (fd<0 || fstat( fd, &st )<0)
+		{
+			std::cerr << "Cannot open file " << filename << std::endl;
+			exit(1);
+		}
+		fresh_ = (size_t)st.st_size!=size_;
+		if ((fresh_ && ftruncate( fd, 0 )<0) || ftruncate( fd, size_ )<0)
+		{
+			std::cerr << "Cannot resize file " << filename << std::endl;
+			exit(1);
+		}
+		map_ = mmap( nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+		close( fd );
+		if (map_==MAP_FAILED)
+		{
+			std::cerr << "Cannot map file " << filename << std::endl;
+			exit(1);
+		}
+		if (fresh_ || memcmp( header()->magic_, magic, 8 ) || header()->version_!=version)
+		{
+			fresh_ = true;
+			memset( map_, 0, size_ );
+			memcpy( header()->magic_, magic, 8 );
+			header()->version_ = version;
+		}
+	}
+
+	~mapped_file_t()
+	{
+		munmap( map_, size_ );
+	}
+
+	mapped_file_t( const mapped_file_t & ) = delete;
+	mapped_file_t &operator=( const mapped_file_t & ) = delete;
+
+	//	True if the data was reset
+	bool fresh() const { return fresh_; }
+
+	//	True if set_complete was called on this file
+	bool complete() const { return header()->complete_; }
+
+	//	The data is flushed first, so a complete file stays whole after a crash
+	void set_complete()
+	{
+		msync( map_, size_, MS_SYNC );
+		header()->complete_ = 1;
+		msync( map_, size_, MS_SYNC );
+	}
+
+	uint8_t *data() const { return (uint8_t *)map_+HEADER; }
+};
+
+//	Fingerprint of the counts of iter<packed_t>, the version of the files storing
+//	them: it changes with ITER_MAX, the square table, the periodicity check or the
+//	escape rules, and the stale files are then rebuilt
+//	(FNV-1a of the counts of a grid of mandelbrot and julia points)
+uint32_t iter_semantics()
+{
+	static const uint32_t version = []()
+	{
+		uint32_t h = 2166136261u;
+		auto mix = [&]( uint32_t v ) { h = (h ^ v)*16777619u; };
+		mix( ITER_MAX );
+		for (int n=0;n!=SQUARETABLE_SIZE;n++)
+			mix( squaretable[n] );
+		packed_t cx = fixed_t( -0.8 ), cy = fixed_t( 0.156 );
+		for (int i=-1024;i<=1024;i+=16)
+			for (int j=-1024;j<=1024;j+=16)
+			{
+				auto x = packed_t::epsilon( j ), y = packed_t::epsilon( i );
+				mix( iter( x, y, x, y ) );
+				mix( iter( cx, cy, x, y ) );
+			}
+		return h;
+	}();
+	return version;
+}
+
+//	Process wide cache of iteration counts, keyed on the packed (x,y,zx,zy)
+//	Lock-free open addressing: each entry is a 64 bits word, 0 when empty, holding
+//	the 4 coordinates on 12 bits each (v/2+2048, never 0) and the count above them
+//	Can be backed by a memory mapped file, so the next runs start warm
+class iter_cache_t
+{
+	static const int PROBES=16;
+
+	int bits_;
+	std::atomic<uint64_t> *entries_ = nullptr;
+	std::unique_ptr<std::atomic<uint64_t>[]> memory_;
+	std::unique_ptr<mapped_file_t> file_;
+
+	static uint64_t field( packed_t v )
+	{
+		return (v.get() >> 1) + 2048;
+	}
+
+	static uint64_t key( packed_t x, packed_t y, packed_t zx, packed_t zy )
+	{
+		return field(x) | field(y) << 12 | field(zx) << 24 | field(zy) << 36;
+	}
+
+	//	Neighbouring zx share a cache line
+	size_t slot( uint64_t key, int probe ) const
+	{
+		uint64_t line = ((key & ~(7ull << 24)) * 0x9E3779B97F4A7C15ull) >> (64-bits_+3);
+		return ((line << 3) + ((key >> 24) & 7) + probe) & ((1ull << bits_)-1);
+	}
+
+public:
+	std::atomic<uint64_t> hits_ = 0;
+	std::atomic<uint64_t> misses_ = 0;
+
+	//	2^bits entries, in memory or in filename
+	iter_cache_t( int bits, const char *filename=nullptr ) : bits_(bits)
+	{
+		size_t count = 1ull << bits_;
+		if (filename)
+		{
+			//	The table size is in the magic, and the counts of another iter are
+			//	dropped with the version
+			char magic[8] = { 'I','T','C','A','C','H','E',(char)bits_ };
+			file_ = std::make_unique<mapped_file_t>( filename, magic, iter_semantics(), count*sizeof(uint64_t) );
+			entries_ = (std::atomic<uint64_t> *)file_->data();
+		}
+		else
+		{
+			memory_.reset( new std::atomic<uint64_t>[count]() );
+			entries_ = memory_.get();
+		}
+	}
+
+	iter_cache_t( const iter_cache_t & ) = delete;
+	iter_cache_t &operator=( const iter_cache_t & ) = delete;
+
+	//	NaN coordinates are never cached
+	static bool cacheable( packed_t x, packed_t y, packed_t zx, packed_t zy )
+	{
+		return !((x.get() | y.get() | zx.get() | zy.get()) & 1);
+	}
+
+	bool find( packed_t x, packed_t y, packed_t zx, packed_t zy, int &it ) const
+	{
+		uint64_t k = key( x, y, zx, zy );
+		for (int p=0;p!=PROBES;p++)
+		{
+			uint64_t e = entries_[slot( k, p )].load( std::memory_order_relaxed );
+			if (e==0)
+				return false;
+			if ((e & 0xffffffffffffull)==k)
+			{
+				it = e >> 48;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	//	Does nothing if the probed entries are all taken
+	void insert( packed_t x, packed_t y, packed_t zx, packed_t zy, int it )
+	{
+		uint64_t k = key( x, y, zx, zy );
+		uint64_t e = k | (uint64_t)it << 48;
+		for (int p=0;p!=PROBES;p++)
+		{
+			auto &entry = entries_[slot( k, p )];
+			uint64_t old = 0;
+			if (entry.compare_exchange_strong( old, e, std::memory_order_relaxed ) || (old & 0xffffffffffffull)==k)
+				return;
+		}
+	}
+};
+
+//	Used by iter_span when set
+iter_cache_t *iter_cache = nullptr;
+
+const int ITER_CACHE_BITS=24;
+const char *ITER_CACHE_NAME = "/tmp/mandel.cache";
+
+//	Iterates n points, using the SIMD kernel for packed_t
+//	(except with STATS, where the scalar iter collects the counters)
+template <typename T>
+void iter_points( const T *x, const T *y, const T *zx, const T *zy, int n, uint8_t *its )
+{
+#ifndef STATS
+	if constexpr (std::is_same_v<T,packed_t>)
+		iter_row( x, y, zx, zy, n, its );
+	else
+#endif
+		for (int k=0;k!=n;k++)
+			its[k] = iter( x[k], y[k], zx[k], zy[k] );
+}
+
+//	Iterates n points, through iter_cache if set
+template <typename T>
+void iter_span( const T *x, const T *y, const T *zx, const T *zy, int n, uint8_t *its )
+{
+	if (!iter_cache)
+	{
+		iter_points( x, y, zx, zy, n, its );
+		return;
+	}
+
+	const int BATCH=64;
+	for (int k0=0;k0<n;k0+=BATCH)
+	{
+		int k1 = std::min( k0+BATCH, n );
+		std::array<T,BATCH> mx, my, mzx, mzy;
+		std::array<int,BATCH> index;
+		std::array<uint8_t,BATCH> res;
+		int misses = 0;
+		for (int k=k0;k!=k1;k++)
+		{
+			int it;
+			if (iter_cache_t::cacheable( x[k], y[k], zx[k], zy[k] ) && iter_cache->find( x[k], y[k], zx[k], zy[k], it ))
+				its[k] = it;
+			else
+			{
+				mx[misses] = x[k];
+				my[misses] = y[k];
+				mzx[misses] = zx[k];
+				mzy[misses] = zy[k];
+				index[misses++] = k;
+			}
+		}
+		iter_points( mx.data(), my.data(), mzx.data(), mzy.data(), misses, res.data() );
+		for (int m=0;m!=misses;m++)
+		{
+			int k = index[m];
+			its[k] = res[m];
+			if (iter_cache_t::cacheable( x[k], y[k], zx[k], zy[k] ))
+				iter_cache->insert( x[k], y[k], zx[k], zy[k], res[m] );
+		}
+		iter_cache->hits_.fetch_add( k1-k0-misses, std::memory_order_relaxed );
+		iter_cache->misses_.fetch_add( misses, std::memory_order_relaxed );
+	}
+}
+
+//	Checks that iter_span gives the same results with and without the cache
+void test_iter_cache()
+{
+	iter_cache_t cache( 12 );
+	std::vector<packed_t> xs, ys;
+	for (int y=-1024;y<=1024;y+=2*37)
+		for (int x=-2048;x<=1024;x+=2*23)
+		{
+			xs.push_back( packed_t::raw( x ) );
+			ys.push_back( packed_t::raw( y ) );
+		}
+	xs.push_back( packed_t::nan() );
+	ys.push_back( packed_t::raw( 0 ) );
+
+	int n = xs.size();
+	std::vector<uint8_t> direct( n ), cold( n ), warm( n );
+	iter_points( xs.data(), ys.data(), xs.data(), ys.data(), n, direct.data() );
+	iter_cache = &cache;
+	iter_span( xs.data(), ys.data(), xs.data(), ys.data(), n, cold.data() );
+	iter_span( xs.data(), ys.data(), xs.data(), ys.data(), n, warm.data() );
+	iter_cache = nullptr;
+	assert( direct==cold && direct==warm );
+	assert( cache.hits_>0 && cache.misses_>=n );
+
+	int it;
+	assert( !cache.find( packed_t::raw( 4094 ), packed_t::raw( 4094 ), packed_t::raw( 2 ), packed_t::raw( 2 ), it ) );
+	cache.insert( packed_t::raw( 4094 ), packed_t::raw( -4094 ), packed_t::raw( 2 ), packed_t::raw( 2 ), 42 );
+	assert( cache.find( packed_t::raw( 4094 ), packed_t::raw( -4094 ), packed_t::raw( 2 ), packed_t::raw( 2 ), it ) && it==42 );
+}
+
+//	Checks that mapped files keep their data, and are reset on another version
+void test_mapped_file()
+{
+	const char *name = "/tmp/mandel_test.map";
+	const char magic[8] = { 'T','E','S','T','M','A','P',0 };
+	unlink( name );
+	{
+		mapped_file_t f( name, magic, 1, 4096 );
+		assert( f.fresh() && !f.complete() );
+		f.data()[4095] = 42;
+	}
+	{
+		//	An unfinished file keeps its data, but is not complete
+		mapped_file_t f( name, magic, 1, 4096 );
+		assert( !f.fresh() && !f.complete() && f.data()[4095]==42 );
+		f.set_complete();
+	}
+	{
+		mapped_file_t f( name, magic, 1, 4096 );
+		assert( !f.fresh() && f.complete() && f.data()[4095]==42 );
+	}
+	{
+		mapped_file_t f( name, magic, 2, 4096 );
+		assert( f.fresh() && !f.complete() && f.data()[4095]==0 );
+	}
+	unlink( name );
+	assert( iter_semantics()==iter_semantics() && iter_semantics()!=0 );
+}
+
+//	Coordinates of each column and row of a place
+//	Computed by repeated additions, exactly like the serial loops
+template <typename T>
+struct lattice_t
+{
+	std::vector<T> xs_;
+	std::vector<T> ys_;
+
+	lattice_t( const place_t &place, T x, T y, T rx, T ry )
+	{
+		for (int j=0;j!=place.w_;j++)
+		{
+			xs_.push_back( x );
+			x = x + rx;
+		}
+		for (int i=0;i!=place.h_;i++)
+		{
+			ys_.push_back( y );
+			y = y + ry;
+		}
+	}
+
+	lattice_t( const place_t &place ) : lattice_t( place, place.x_, place.y_, place.rx_, place.ry_ ) {}
+};
+
+//	Sends the characters of the iteration counts of a lattice, a row at a time
+template <typename T>
+void output_its( const place_t &place, const lattice_t<T> &l, const std::vector<uint8_t> &its, ioutput &out )
+{
+	out.output_start( place.description(), place.w_, place.h_ );
+	std::vector<char> chars( place.w_ );
+	for (int i=0;i!=place.h_;i++)
+	{
+		palette_row( palette_lut, &its[i*place.w_], place.w_, chars.data() );
+		for (int j=0;j!=place.w_;j++)
+			out.output( chars[j], l.xs_[j], l.ys_[i] );
+	}
+	out.output_end();
+}
+
+//	Multithreaded versions of mandel, mandelhr and julia
+//	The iteration counts are computed first, then sent in order to the output
+template <typename T=fixed_t>
+void mandel_mt( const place_t &place, ioutput &out, const tile_pool_t &pool=tile_pool )
+{
+	std::cout << place.description() << "\n";
+	lattice_t<T> l( place );
+	std::vector<uint8_t> its( place.w_*place.h_ );
+
+	render_tiles( place.w_, place.h_, [&]( int i, int j0, int j1 )
+	{
+		std::array<T,TILE_W> y;
+		y.fill( l.ys_[i] );
+		iter_span( &l.xs_[j0], y.data(), &l.xs_[j0], y.data(), j1-j0, &its[i*place.w_+j0] );
+	}, pool );
+
+	output_its( place, l, its, out );
+}
+
+template <typename T=fixed_t>
+void mandelhr_mt( const place_t &place, ioutput &out, const font_t &font, const tile_pool_t &pool=tile_pool )
+{
+	const T rxhr = place.rx_.div2();
+	const T ryhr = place.ry_.div2();
+
+	lattice_t<T> l( place );
+	std::vector<T> xs1, ys1;
+	for (auto x:l.xs_)
+		xs1.push_back( x + rxhr );
+	for (auto y:l.ys_)
+		ys1.push_back( y + ryhr );
+
+	//	One plane per sub-sample
+	int size = place.w_*place.h_;
+	std::vector<uint8_t> its( 4*size );
+
+	render_tiles( place.w_, place.h_, [&]( int i, int j0, int j1 )
+	{
+		std::array<T,TILE_W> y0, y1;
+		y0.fill( l.ys_[i] );
+		y1.fill( ys1[i] );
+		const T *x0 = &l.xs_[j0];
+		const T *x1 = &xs1[j0];
+		uint8_t *it = &its[i*place.w_+j0];
+		iter_span( x0, y0.data(), x0, y0.data(), j1-j0, it );
+		iter_span( x1, y0.data(), x0, y1.data(), j1-j0, it+size );
+		iter_span( x0, y1.data(), x1, y0.data(), j1-j0, it+2*size );
+		iter_span( x1, y1.data(), x1, y1.data(), j1-j0, it+3*size );
+	}, pool );
+
+	out.output_start( place.description(), place.w_, place.h_ );
+	std::vector<char> chars( place.w_ );
+	for (int i=0;i!=place.h_;i++)
+	{
+		auto it = &its[i*place.w_];
+		font.best_row( it, it+size, it+2*size, it+3*size, place.w_, chars.data() );
+		for (int j=0;j!=place.w_;j++)
+			out.output( chars[j], l.xs_[j], l.ys_[i] );
+	}
+	out.output_end();
+}
+
+template <typename T=fixed_t>
+void julia_mt( const place_t &place, fixed_t cx, fixed_t cy, ioutput &out, const tile_pool_t &pool=tile_pool )
+{
+	std::array<T,TILE_W> tcx, tcy;
+	tcx.fill( cx );
+	tcy.fill( cy );
+	lattice_t<T> l( place );
+	std::vector<uint8_t> its( place.w_*place.h_ );
+
+	render_tiles( place.w_, place.h_, [&]( int i, int j0, int j1 )
+	{
+		std::array<T,TILE_W> y;
+		y.fill( l.ys_[i] );
+		iter_span( tcx.data(), tcy.data(), &l.xs_[j0], y.data(), j1-j0, &its[i*place.w_+j0] );
+	}, pool );
+
+	output_its( place, l, its, out );
+}
+
+//	Adaptive version of mandelhr: each cell starts with one sample at its corner
+//	Cells whose level differs from a neighbour get 2x2 samples, and those whose 2x2
+//	samples differ get 4x4, matched with font_t::best16
+//	(unlike mandelhr, every sample starts from z=c)
+struct hr_stats_t
+{
+	uint64_t samples_ = 0;		//	Points iterated
+	uint64_t iterations_ = 0;	//	Sum of their iteration counts
+	uint64_t cells_[3] = {};	//	Cells with 1, 2x2 and 4x4 samples
+};
+
+const int HR_SUB=4;				//	Sub-samples per side of a fully refined cell
+
+template <typename T=fixed_t>
+hr_stats_t mandelhr_adaptive( const place_t &place, ioutput &out, const font_t &font, bool full=false, const tile_pool_t &pool=tile_pool )
+{
+	const int w = place.w_;
+	const int h = place.h_;
+	const int N = HR_SUB*HR_SUB;
+
+	//	Coordinates of the sub-sample columns and lines
+	lattice_t<T> l( place );
+	const T qx = place.rx_.div2().div2();
+	const T qy = place.ry_.div2().div2();
+	std::vector<T> xs( w*HR_SUB ), ys( h*HR_SUB );
+	for (int j=0;j!=w*HR_SUB;j++)
+		xs[j] = j%HR_SUB ? xs[j-1]+qx : l.xs_[j/HR_SUB];
+	for (int i=0;i!=h*HR_SUB;i++)
+		ys[i] = i%HR_SUB ? ys[i-1]+qy : l.ys_[i/HR_SUB];
+
+	//	N counts per cell, line by line, and the number of samples per side of each cell
+	std::vector<uint8_t> its( w*h*N );
+	std::vector<uint8_t> side( w*h, 1 );
+	std::atomic<uint64_t> samples = 0, iterations = 0;
+
+	//	Iterates the sub-samples sub[] of the cells of line i
+	auto run = [&]( int i, const std::vector<std::pair<int,int>> &todo )
+	{
+		std::vector<T> x, y;
+		for (auto [j,sub]:todo)
+		{
+			x.push_back( xs[j*HR_SUB+sub%HR_SUB] );
+			y.push_back( ys[i*HR_SUB+sub/HR_SUB] );
+		}
+		std::vector<uint8_t> res( todo.size() );
+		iter_span( x.data(), y.data(), x.data(), y.data(), todo.size(), res.data() );
+		uint64_t sum = 0;
+		for (size_t k=0;k!=todo.size();k++)
+		{
+			its[(i*w+todo[k].first)*N+todo[k].second] = res[k];
+			sum += res[k];
+		}
+		samples.fetch_add( todo.size(), std::memory_order_relaxed );
+		iterations.fetch_add( sum, std::memory_order_relaxed );
+	};
+
+	render_tiles( w, h, [&]( int i, int j0, int j1 )
+	{
+		std::vector<std::pair<int,int>> todo;
+		for (int j=j0;j!=j1;j++)
+			for (int sub=0;sub!=(full ? N : 1);sub++)
+				todo.push_back( { j, sub } );
+		run( i, todo );
+		if (full)
+			for (int j=j0;j!=j1;j++)
+				side[i*w+j] = HR_SUB;
+	}, pool );
+
+	if (!full)
+		render_tiles( w, h, [&]( int i, int j0, int j1 )
+		{
+			//	Corners of the 2x2 quadrants, then the rest of the 4x4
+			const int quads[] = { HR_SUB/2, HR_SUB/2*HR_SUB, HR_SUB/2*HR_SUB+HR_SUB/2 };
+			std::vector<std::pair<int,int>> todo;
+			for (int j=j0;j!=j1;j++)
+			{
+				int level = font_t::level( its[(i*w+j)*N] );
+				bool edge = false;
+				for (int di=-1;di<=1;di++)
+					for (int dj=-1;dj<=1;dj++)
+						if (i+di>=0 && i+di<h && j+dj>=0 && j+dj<w)
+							edge |= font_t::level( its[((i+di)*w+j+dj)*N] )!=level;
+				if (edge)
+				{
+					side[i*w+j] = 2;
+					for (int sub:quads)
+						todo.push_back( { j, sub } );
+				}
+			}
+			run( i, todo );
+
+			todo.clear();
+			for (int j=j0;j!=j1;j++)
+			{
+				const uint8_t *it = &its[(i*w+j)*N];
+				if (side[i*w+j]==2 && !(font_t::level( it[quads[0]] )==font_t::level( it[0] ) &&
+					font_t::level( it[quads[1]] )==font_t::level( it[0] ) && font_t::level( it[quads[2]] )==font_t::level( it[0] )))
+				{
+					side[i*w+j] = HR_SUB;
+					for (int sub=1;sub!=N;sub++)
+						if (sub!=quads[0] && sub!=quads[1] && sub!=quads[2])
+							todo.push_back( { j, sub } );
+				}
+			}
+			run( i, todo );
+		}, pool );
+
+	hr_stats_t stats;
+	stats.samples_ = samples;
+	stats.iterations_ = iterations;
+
+	out.output_start( place.description(), w, h );
+	for (int i=0;i!=h;i++)
+		for (int j=0;j!=w;j++)
+		{
+			const uint8_t *it = &its[(i*w+j)*N];
+			char c;
+			if (side[i*w+j]==1)
+				c = font.best( it[0], it[0], it[0], it[0] );
+			else if (side[i*w+j]==2)
+				c = font.best( it[0], it[HR_SUB/2], it[HR_SUB/2*HR_SUB], it[HR_SUB/2*HR_SUB+HR_SUB/2] );
+			else
+				c = font.best16( it );
+			stats.cells_[side[i*w+j]/2]++;
+			out.output( c, l.xs_[j], l.ys_[i] );
+		}
+	out.output_end();
+	return stats;
+}
+
+void print_hr_stats( const hr_stats_t &stats )
+{
+	std::cout << "Adaptive: " << stats.samples_ << " samples, " << stats.iterations_ << " iterations, cells "
+		<< stats.cells_[0] << " x1, " << stats.cells_[1] << " x4, " << stats.cells_[2] << " x16" << std::endl;
+}
+
+
+//	Mariani-Silver renders: when the border of a rectangle and the border one pixel
+//	inside have a single iteration count, the rest is filled with it without iterating
+//	This holds for the exact sets (they are connected), not always for the fixed
+//	point ones: a lone point inside a filled rectangle would be missed. The second
+//	border removes all the mismatches a single border had on the places of main and
+//	of the tests, but is not a proof, so these renders are approximate
+//	With verify, the full render is also done, its counts are the ones output (so
+//	the stream is exactly the mandel_mt one) and the mismatches are counted
+struct ms_stats_t
+{
+	uint64_t computed_ = 0;		//	Points iterated
+	uint64_t avoided_ = 0;		//	Points filled without iterating
+	uint64_t mismatches_ = 0;	//	Points different from the full render (if verified)
+};
+
+const int MS_TILE=64;			//	Each tile is subdivided independently
+const int MS_MIN=4;				//	Rectangles this small are iterated
+const uint8_t MS_UNKNOWN=0xff;
+
+//	Fills its with the iteration counts of a w x h grid
+//	points(k,n,it) iterates the n (at most MS_TILE) points whose indexes (i*w+j) are in k into it
+//	Points already in its (not MS_UNKNOWN) are not iterated again: its is only
+//	reset if it is not w x h
+template <typename F>
+ms_stats_t ms_render( int w, int h, std::vector<uint8_t> &its, F points, bool verify, const tile_pool_t &pool )
+{
+	if (its.size()!=(size_t)w*h)
+		its.assign( w*h, MS_UNKNOWN );
+	std::mutex mutex;
+	ms_stats_t stats;
+
+	int tw = (w+MS_TILE-1)/MS_TILE;
+	int th = (h+MS_TILE-1)/MS_TILE;
+	pool.run( tw*th, [&]( int tile )
+	{
+		ms_stats_t s;
+
+		//	Unknown points are batched, so the SIMD kernel is used on borders too
+		std::array<int,MS_TILE> batch;
+		std::array<uint8_t,MS_TILE> result;
+		int pending = 0;
+		auto flush = [&]()
+		{
+			points( batch.data(), pending, result.data() );
+			for (int k=0;k!=pending;k++)
+				its[batch[k]] = result[k];
+			s.computed_ += pending;
+			pending = 0;
+		};
+		auto add = [&]( int i, int j0, int j1 )
+		{
+			for (int j=j0;j<j1;j++)
+				if (its[i*w+j]==MS_UNKNOWN)
+				{
+					batch[pending++] = i*w+j;
+					if (pending==MS_TILE)
+						flush();
+				}
+		};
+
+		//	Rectangle [i0,i1]x[j0,j1], bounds included
+		auto subdivide = [&]( auto &self, int i0, int j0, int i1, int j1 ) -> void
+		{
+			add( i0, j0, j1+1 );
+			add( i1, j0, j1+1 );
+			for (int i=i0+1;i<i1;i++)
+			{
+				add( i, j0, j0+1 );
+				add( i, j1, j1+1 );
+			}
+			flush();
+			if (i1-i0<2 || j1-j0<2)
+				return;
+
+			//	Whether the border of [i0,i1]x[j0,j1] is all v
+			auto uniform = [&]( int i0, int j0, int i1, int j1, uint8_t v )
+			{
+				bool same = true;
+				for (int j=j0;j<=j1 && same;j++)
+					same = its[i0*w+j]==v && its[i1*w+j]==v;
+				for (int i=i0;i<=i1 && same;i++)
+					same = its[i*w+j0]==v && its[i*w+j1]==v;
+				return same;
+			};
+
+			//	The border and the one pixel inset border must agree
+			uint8_t v = its[i0*w+j0];
+			bool same = i1-i0>MS_MIN && j1-j0>MS_MIN && uniform( i0, j0, i1, j1, v );
+			if (same)
+			{
+				add( i0+1, j0+1, j1 );
+				add( i1-1, j0+1, j1 );
+				for (int i=i0+2;i<i1-1;i++)
+				{
+					add( i, j0+1, j0+2 );
+					add( i, j1-1, j1 );
+				}
+				flush();
+				same = uniform( i0+1, j0+1, i1-1, j1-1, v );
+			}
+
+			if (same)
+			{
+				for (int i=i0+2;i<i1-1;i++)
+					for (int j=j0+2;j<j1-1;j++)
+						if (its[i*w+j]==MS_UNKNOWN)
+						{
+							its[i*w+j] = v;
+							s.avoided_++;
+						}
+			}
+			else if (i1-i0<=MS_MIN && j1-j0<=MS_MIN)
+			{
+				for (int i=i0+1;i<i1;i++)
+					add( i, j0+1, j1 );
+				flush();
+			}
+			else if (j1-j0>=i1-i0)
+			{
+				int jm = (j0+j1)/2;
+				self( self, i0, j0, i1, jm );
+				self( self, i0, jm, i1, j1 );
+			}
+			else
+			{
+				int im = (i0+i1)/2;
+				self( self, i0, j0, im, j1 );
+				self( self, im, j0, i1, j1 );
+			}
+		};
+
+		int i0 = tile/tw*MS_TILE;
+		int j0 = tile%tw*MS_TILE;
+		subdivide( subdivide, i0, j0, std::min( i0+MS_TILE, h )-1, std::min( j0+MS_TILE, w )-1 );
+
+		std::lock_guard<std::mutex> lock(mutex);
+		stats.computed_ += s.computed_;
+		stats.avoided_ += s.avoided_;
+	} );
+
+	if (verify)
+	{
+		std::vector<uint8_t> full( w*h );
+		pool.run( h, [&]( int i )
+		{
+			std::array<int,MS_TILE> batch;
+			for (int j=0;j<w;j+=MS_TILE)
+			{
+				int n = std::min( MS_TILE, w-j );
+				for (int k=0;k!=n;k++)
+					batch[k] = i*w+j+k;
+				points( batch.data(), n, &full[i*w+j] );
+			}
+		} );
+		for (int k=0;k!=w*h;k++)
+			stats.mismatches_ += full[k]!=its[k];
+		its = full;
+	}
+
+	return stats;
+}
+
+void print_ms_stats( const ms_stats_t &stats, bool verify )
+{
+	uint64_t total = stats.computed_+stats.avoided_;
+	std::cout << "Mariani-Silver: " << stats.computed_ << " iterated, " << stats.avoided_ << " avoided ("
+		<< (total ? 100*stats.avoided_/total : 0) << "%)";
+	if (verify)
+		std::cout << ", " << stats.mismatches_ << " mismatches";
+	std::cout << std::endl;
+}
+
+template <typename T=fixed_t>
+ms_stats_t mandel_ms( const place_t &place, ioutput &out, bool verify=false, const tile_pool_t &pool=tile_pool )
+{
+	std::cout << place.description() << "\n";
+	lattice_t<T> l( place );
+	std::vector<uint8_t> its;
+
+	auto stats = ms_render( place.w_, place.h_, its, [&]( const int *k, int n, uint8_t *it )
+	{
+		std::array<T,MS_TILE> x, y;
+		for (int p=0;p!=n;p++)
+		{
+			x[p] = l.xs_[k[p]%place.w_];
+			y[p] = l.ys_[k[p]/place.w_];
+		}
+		iter_span( x.data(), y.data(), x.data(), y.data(), n, it );
+	}, verify, pool );
+	print_ms_stats( stats, verify );
+
+	output_its( place, l, its, out );
+	return stats;
+}
+
+template <typename T=fixed_t>
+ms_stats_t julia_ms( const place_t &place, fixed_t cx, fixed_t cy, ioutput &out, bool verify=false, const tile_pool_t &pool=tile_pool )
+{
+	std::array<T,MS_TILE> tcx, tcy;
+	tcx.fill( cx );
+	tcy.fill( cy );
+	lattice_t<T> l( place );
+	std::vector<uint8_t> its;
+
+	auto stats = ms_render( place.w_, place.h_, its, [&]( const int *k, int n, uint8_t *it )
+	{
+		std::array<T,MS_TILE> x, y;
+		for (int p=0;p!=n;p++)
+		{
+			x[p] = l.xs_[k[p]%place.w_];
+			y[p] = l.ys_[k[p]/place.w_];
+		}
+		iter_span( tcx.data(), tcy.data(), x.data(), y.data(), n, it );
+	}, verify, pool );
+	print_ms_stats( stats, verify );
+
+	output_its( place, l, its, out );
+	return stats;
+}
+
+//	Iteration count of every mandelbrot point, indexed by the packed coordinates
+//	Outside of |v/2|<=ESCAPE_LIMIT the first square is NaN and the count 0, so
+//	only that square is stored (2MB, instead of 16MB for all the packed values)
+const int ESCAPE_LIMIT=724;
+static_assert( !(squaretable[ESCAPE_LIMIT] & 1) && (squaretable[ESCAPE_LIMIT+1] & 1) );
+
+const char *ESCAPE_MAP_NAME = "/tmp/mandel.map";
+
+class escape_map_t
+{
+	static const int SIZE=2*ESCAPE_LIMIT+1;
+	static constexpr char MAGIC[8] = { 'E','S','C','M','A','P','2',0 };
+
+	uint8_t *data_;
+	std::vector<uint8_t> memory_;
+	std::unique_ptr<mapped_file_t> file_;
+
+	void build( const tile_pool_t &pool )
+	{
+		pool.run( SIZE, [&]( int i )
+		{
+			std::vector<packed_t> xs( SIZE );
+			std::vector<packed_t> ys( SIZE, packed_t::epsilon( i-ESCAPE_LIMIT ) );
+			for (int j=0;j!=SIZE;j++)
+				xs[j] = packed_t::epsilon( j-ESCAPE_LIMIT );
+			iter_points( xs.data(), ys.data(), xs.data(), ys.data(), SIZE, data_+i*SIZE );
+		} );
+	}
+
+public:
+	//	Loaded from filename if it holds a map, or built (and saved) once
+	escape_map_t( const char *filename=nullptr, const tile_pool_t &pool=tile_pool )
+	{
+		if (filename)
+		{
+			file_ = std::make_unique<mapped_file_t>( filename, MAGIC, iter_semantics(), SIZE*SIZE );
+			data_ = file_->data();
+			//	A build that did not finish is redone
+			if (!file_->complete())
+			{
+				build( pool );
+				file_->set_complete();
+			}
+		}
+		else
+		{
+			memory_.resize( SIZE*SIZE );
+			data_ = memory_.data();
+			build( pool );
+		}
+	}
+
+	int at( int kx, int ky ) const
+	{
+		return data_[(ky+ESCAPE_LIMIT)*SIZE+kx+ESCAPE_LIMIT];
+	}
+
+	//	Same as iter<packed_t>(x,y,x,y)
+	int get( packed_t x, packed_t y ) const
+	{
+		if (x.is_nan() || y.is_nan())
+			return 0;
+		int kx = x.get() >> 1;
+		int ky = y.get() >> 1;
+		if (kx<-ESCAPE_LIMIT || kx>ESCAPE_LIMIT || ky<-ESCAPE_LIMIT || ky>ESCAPE_LIMIT)
+			return 0;
+		return at( kx, ky );
+	}
+};
+
+//	mandel, reading the counts from the escape map
+template <typename T=fixed_t>
+void mandel_map( const place_t &place, ioutput &out, const escape_map_t &map )
+{
+	std::cout << place.description() << "\n";
+	lattice_t<T> l( place );
+	out.output_start( place.description(), place.w_, place.h_ );
+	for (int i=0;i!=place.h_;i++)
+		for (int j=0;j!=place.w_;j++)
+			out.output( palette(map.get( l.xs_[j], l.ys_[i] )), l.xs_[j], l.ys_[i] );
+	out.output_end();
+}
+
+//	Zoom renders: when a frame zooms in on the previous one (half the delta, centered
+//	on a point of its lattice) a quarter of its points are points of the previous
+//	frame, and their iteration counts are carried forward instead of recomputed
+
+//	For each column and row of a frame, the column and row of the previous frame
+//	with the same coordinate, or -1
+struct reuse_map_t
+{
+	std::vector<int> cols_;
+	std::vector<int> rows_;
+
+	//	Coordinates are keys of any ordered type
+	template <typename V>
+	static std::vector<int> axis( const std::vector<V> &from, const std::vector<V> &to )
+	{
+		std::map<V,int> index;
+		for (int k=0;k!=(int)from.size();k++)
+			index.emplace( from[k], k );
+		std::vector<int> r;
+		for (auto &v:to)
+		{
+			auto p = index.find( v );
+			r.push_back( p==index.end() ? -1 : p->second );
+		}
+		return r;
+	}
+
+	reuse_map_t() {}
+
+	template <typename V>
+	reuse_map_t( const std::vector<V> &xs0, const std::vector<V> &ys0, const std::vector<V> &xs, const std::vector<V> &ys ) :
+		cols_( axis( xs0, xs ) ), rows_( axis( ys0, ys ) ) {}
+
+	int reused() const
+	{
+		return std::count_if( cols_.begin(), cols_.end(), []( int j ) { return j>=0; } ) *
+			std::count_if( rows_.begin(), rows_.end(), []( int i ) { return i>=0; } );
+	}
+};
+
+//	Lattice coordinates as reuse map keys (a NaN coordinate is never reused)
+template <typename T>
+std::vector<float> zoom_keys( const std::vector<T> &vs, float nan )
+{
+	std::vector<float> keys;
+	for (auto &v:vs)
+		keys.push_back( v.is_nan() ? nan : v.to_float() );
+	return keys;
+}
+
+//	The previous frame of a zoom (empty at the start)
+struct zoom_frame_t
+{
+	std::vector<float> xs_;
+	std::vector<float> ys_;
+	std::vector<uint8_t> its_;
+};
+
+struct zoom_stats_t
+{
+	uint64_t reused_ = 0;		//	Points of the previous frame
+	uint64_t computed_ = 0;		//	Points iterated
+	uint64_t avoided_ = 0;		//	Points inferred by Mariani-Silver
+};
+
+//	Fills its with the iteration counts of the w x h grid of lattice l, reusing frame,
+//	and makes it the new frame
+//	points(i,j,n,it) iterates the n (at most MS_TILE) points of line i whose columns are in j into it
+//	With infer, the other points go through ms_render (not always exact, see ms_stats_t)
+template <typename T, typename F>
+zoom_stats_t zoom_render( const lattice_t<T> &l, zoom_frame_t &frame, std::vector<uint8_t> &its, F points, bool infer, const tile_pool_t &pool )
+{
+	int w = l.xs_.size();
+	int h = l.ys_.size();
+	auto xs = zoom_keys( l.xs_, -INFINITY );
+	auto ys = zoom_keys( l.ys_, -INFINITY );
+	reuse_map_t map( frame.xs_, frame.ys_, xs, ys );
+	int w0 = frame.xs_.size();
+
+	zoom_stats_t stats;
+	stats.reused_ = map.reused();
+	its.assign( w*h, MS_UNKNOWN );
+	for (int i=0;i!=h;i++)
+		if (map.rows_[i]>=0)
+			for (int j=0;j!=w;j++)
+				if (map.cols_[j]>=0)
+					its[i*w+j] = frame.its_[map.rows_[i]*w0+map.cols_[j]];
+
+	if (infer)
+	{
+		//	Batches of ms_render are split by line
+		auto ms = ms_render( w, h, its, [&]( const int *k, int n, uint8_t *it )
+		{
+			std::array<int,MS_TILE> j;
+			for (int p=0,q;p<n;p=q)
+			{
+				int i = k[p]/w;
+				for (q=p;q<n && k[q]/w==i;q++)
+					j[q-p] = k[q]-i*w;
+				points( i, j.data(), q-p, it+p );
+			}
+		}, false, pool );
+		stats.computed_ = ms.computed_;
+		stats.avoided_ = ms.avoided_;
+	}
+	else
+	{
+		std::atomic<uint64_t> computed = 0;
+		render_tiles( w, h, [&]( int i, int j0, int j1 )
+		{
+			std::array<int,TILE_W> batch;
+			std::array<uint8_t,TILE_W> result;
+			int n = 0;
+			for (int j=j0;j!=j1;j++)
+				if (its[i*w+j]==MS_UNKNOWN)
+					batch[n++] = j;
+			points( i, batch.data(), n, result.data() );
+			for (int k=0;k!=n;k++)
+				its[i*w+batch[k]] = result[k];
+			computed += n;
+		}, pool );
+		stats.computed_ = computed;
+	}
+
+	//	NaN coordinates of the old frame must not match the new ones
+	frame.xs_ = zoom_keys( l.xs_, INFINITY );
+	frame.ys_ = zoom_keys( l.ys_, INFINITY );
+	frame.its_ = its;
+	return stats;
+}
+
+void print_zoom_stats( const zoom_stats_t &stats )
+{
+	uint64_t total = stats.reused_+stats.computed_+stats.avoided_;
+	std::cout << "Zoom: " << stats.reused_ << " reused, " << stats.avoided_ << " inferred, " << stats.computed_ << " iterated ("
+		<< (total ? 100*stats.computed_/total : 0) << "%)" << std::endl;
+}
+
+template <typename T=fixed_t>
+zoom_stats_t mandel_zoom( const place_t &place, ioutput &out, zoom_frame_t &frame, bool infer=false, const tile_pool_t &pool=tile_pool )
+{
+	std::cout << place.description() << "\n";
+	lattice_t<T> l( place );
+	std::vector<uint8_t> its;
+
+	auto stats = zoom_render( l, frame, its, [&]( int i, const int *j, int n, uint8_t *it )
+	{
+		std::array<T,MS_TILE> x, y;
+		y.fill( l.ys_[i] );
+		for (int p=0;p!=n;p++)
+			x[p] = l.xs_[j[p]];
+		iter_span( x.data(), y.data(), x.data(), y.data(), n, it );
+	}, infer, pool );
+	print_zoom_stats( stats );
+
+	output_its( place, l, its, out );
+	return stats;
+}
+
+template <typename T=fixed_t>
+zoom_stats_t julia_zoom( const place_t &place, fixed_t cx, fixed_t cy, ioutput &out, zoom_frame_t &frame, bool infer=false, const tile_pool_t &pool=tile_pool )
+{
+	std::array<T,MS_TILE> tcx, tcy;
+	tcx.fill( cx );
+	tcy.fill( cy );
+	lattice_t<T> l( place );
+	std::vector<uint8_t> its;
+
+	auto stats = zoom_render( l, frame, its, [&]( int i, const int *j, int n, uint8_t *it )
+	{
+		std::array<T,MS_TILE> x, y;
+		y.fill( l.ys_[i] );
+		for (int p=0;p!=n;p++)
+			x[p] = l.xs_[j[p]];
+		iter_span( tcx.data(), tcy.data(), x.data(), y.data(), n, it );
+	}, infer, pool );
+	print_zoom_stats( stats );
+
+	output_its( place, l, its, out );
+	return stats;
+}
+
+//	-----------------------------------------------------------------------------
+//	Deep zooms, by perturbation
+//	-----------------------------------------------------------------------------
+
+//	Double-double: an unevaluated sum hi_+lo_ with |lo_| <= ulp(hi_)/2, so about
+//	106 bits of mantissa. Only used for the coordinates and the reference orbit
+struct dd_t
+{
+	double hi_ = 0;
+	double lo_ = 0;
+
+	dd_t() {}
+	dd_t( double v ) : hi_(v) {}
+	dd_t( double hi, double lo ) : hi_(hi), lo_(lo) {}
+
+	//	Exact sum of two doubles, when |a| >= |b|
+	static dd_t quick_two_sum( double a, double b )
+	{
+		double s = a+b;
+		return dd_t( s, b-(s-a) );
+	}
+
+	//	Exact sum of two doubles
+	static dd_t two_sum( double a, double b )
+	{
+		double s = a+b;
+		double bb = s-a;
+		return dd_t( s, (a-(s-bb))+(b-bb) );
+	}
+
+	//	Exact product of two doubles (Dekker, as there may be no fma)
+	static dd_t two_prod( double a, double b )
+	{
+		const double SPLIT = 134217729.0;	//	2^27+1
+		double p = a*b;
+		double ta = SPLIT*a, ah = ta-(ta-a), al = a-ah;
+		double tb = SPLIT*b, bh = tb-(tb-b), bl = b-bh;
+		return dd_t( p, ((ah*bh-p)+ah*bl+al*bh)+al*bl );
+	}
+
+	dd_t operator-() const { return dd_t( -hi_, -lo_ ); }
+
+	friend dd_t operator+( dd_t a, dd_t b )
+	{
+		dd_t s = two_sum( a.hi_, b.hi_ );
+		dd_t t = two_sum( a.lo_, b.lo_ );
+		s = quick_two_sum( s.hi_, s.lo_+t.hi_ );
+		return quick_two_sum( s.hi_, s.lo_+t.lo_ );
+	}
+
+	friend dd_t operator-( dd_t a, dd_t b ) { return a+(-b); }
+
+	friend dd_t operator*( dd_t a, dd_t b )
+	{
+		dd_t p = two_prod( a.hi_, b.hi_ );
+		return quick_two_sum( p.hi_, p.lo_+(a.hi_*b.lo_+a.lo_*b.hi_) );
+	}
+
+	friend dd_t operator/( dd_t a, double b )
+	{
+		double q1 = a.hi_/b;
+		dd_t r = a-two_prod( q1, b );
+		return quick_two_sum( q1, r.hi_/b );
+	}
+
+	//	Decimal number, with an optional exponent ("-0.75", "1e-20")
+	//	Returns false if s is not entirely a number
+	static bool parse( const char *s, dd_t &v )
+	{
+		bool negative = *s=='-';
+		if (*s=='-' || *s=='+')
+			s++;
+		v = dd_t();
+		int scale = 0;
+		bool digits = false, point = false;
+		for (;*s;s++)
+		{
+			if (*s>='0' && *s<='9')
+			{
+				v = v*10.0+dd_t( *s-'0' );
+				scale -= point;
+				digits = true;
+			}
+			else if (*s=='.' && !point)
+				point = true;
+			else
+				break;
+		}
+		if (*s=='e' || *s=='E')
+		{
+			char *end;
+			scale += strtol( s+1, &end, 10 );
+			if (end==s+1)
+				return false;
+			s = end;
+		}
+		for (;scale>0;scale--)
+			v = v*10.0;
+		for (;scale<0;scale++)
+			v = v/10.0;
+		if (negative)
+			v = -v;
+		return digits && !*s;
+	}
+
+	//	Fixed notation, with decimals digits after the point (|v| < 10)
+	std::string to_string( int decimals=32 ) const
+	{
+		std::string s = hi_<0 ? "-" : "";
+		dd_t v = hi_<0 ? -*this : *this;
+		for (int k=-1;k!=decimals;k++)
+		{
+			int d = (int)v.hi_;
+			if ((v-dd_t( d )).hi_<0)
+				d--;
+			s += '0'+d;
+			if (k==-1)
+				s += '.';
+			v = (v-dd_t( d ))*10.0;
+		}
+		return s;
+	}
+};
+
+//	Same escape as fixed_t, whose squares overflow from 8
+const double DEEP_ESCAPE = 8.0;
+//	Iterations between two refills of the SIMD lanes
+const int DEEP_UNROLL = 8;
+
+//	Default deep zoom, in the seahorse valley (precise to 33 digits)
+const char *DEEP_X = "-0.743643887037158704752191506114774";
+const char *DEEP_Y = "0.131825904205311970493132056385139";
+const int DEEP_MAXITER = 50000;
+const int DEEP_DEPTH = 96;		//	Halvings of the first step (3/40)
+const int DEEP_FRAME = 8;		//	Halvings between two frames
+
+//	A place given by its center in double-double and its steps in double, so
+//	zooms go far beyond the epsilon of fixed_t
+struct deep_place_t
+{
+	dd_t x_;
+	dd_t y_;
+	double rx_;
+	double ry_;
+
+	int w_ = 40;
+	int h_ = 24;
+
+	deep_place_t( dd_t x, dd_t y, double rx, double ry, int w=40, int h=24 ) : x_(x), y_(y), rx_(rx), ry_(ry), w_(w), h_(h) {}
+
+	//	Same points as place (which stores the top left corner)
+	deep_place_t( const place_t &place ) :
+		x_(dd_t( place.x_.to_float() )+dd_t::two_prod( place.rx_.to_float(), place.w_/2 )),
+		y_(dd_t( place.y_.to_float() )+dd_t::two_prod( place.ry_.to_float(), place.h_/2 )),
+		rx_(place.rx_.to_float()), ry_(place.ry_.to_float()), w_(place.w_), h_(place.h_) {}
+
+	//	Offsets of column j and line i from the center
+	double dx( int j ) const { return (j-w_/2)*rx_; }
+	double dy( int i ) const { return (i-h_/2)*ry_; }
+
+	std::string description() const
+	{
+		std::stringstream ss;
+		ss << "x= " << x_.to_string() << " y= " << y_.to_string() << " rx= " << rx_ << " ry= " << ry_;
+		return ss.str();
+	}
+};
+
+//	High precision orbit of the center, rounded to double
+//	Stops at maxiter or after the first escaping point
+struct deep_orbit_t
+{
+	std::vector<double> x_;
+	std::vector<double> y_;
+
+	deep_orbit_t( dd_t cx, dd_t cy, int maxiter )
+	{
+		dd_t zx, zy;
+		for (int n=0;n<=maxiter;n++)
+		{
+			x_.push_back( zx.hi_ );
+			y_.push_back( zy.hi_ );
+			if (zx.hi_*zx.hi_+zy.hi_*zy.hi_>=DEEP_ESCAPE)
+				break;
+			dd_t zxy = zx*zy;
+			zx = zx*zx-zy*zy+cx;
+			zy = zxy+zxy+cy;
+		}
+	}
+
+	int last() const { return x_.size()-1; }
+};
+
+//	Iteration count of the point at (dcx,dcy) from the orbit center, with the
+//	same meaning as iter(): z starts at c and is counted until it escapes
+//	The delta d to the orbit Z follows d' = 2Zd + d^2 + dc in double. When z gets
+//	smaller than d, d has lost the precision that z needs (a glitch), so z
+//	becomes the new delta from the start of the orbit (rebase). This also
+//	happens at the end of an orbit that escapes early
+int iter_deep( const deep_orbit_t &orbit, double dcx, double dcy, int maxiter, uint64_t &rebases )
+{
+	const int last = orbit.last();
+	double dx = 0, dy = 0;
+	int m = 0;
+	for (int i=0;i!=maxiter;i++)
+	{
+		double zx = orbit.x_[m], zy = orbit.y_[m];
+		double ndx = 2*(zx*dx-zy*dy)+(dx*dx-dy*dy)+dcx;
+		double ndy = 2*(zx*dy+zy*dx)+2*dx*dy+dcy;
+		dx = ndx;
+		dy = ndy;
+		m++;
+		double x = orbit.x_[m]+dx, y = orbit.y_[m]+dy;
+		double r2 = x*x+y*y;
+		if (r2>=DEEP_ESCAPE)
+			return i;
+		if (r2<dx*dx+dy*dy || m==last)
+		{
+			dx = x;
+			dy = y;
+			m = 0;
+			rebases++;
+		}
+	}
+	return maxiter;
+}
+
+//	Reference iteration count, all in double-double (slow, for tests)
+int iter_dd( dd_t cx, dd_t cy, int maxiter )
+{
+	dd_t zx = cx, zy = cy;
+	for (int i=0;i!=maxiter;i++)
+	{
+		if (zx.hi_*zx.hi_+zy.hi_*zy.hi_>=DEEP_ESCAPE)
+			return i;
+		dd_t zxy = zx*zy;
+		zx = zx*zx-zy*zy+cx;
+		zy = zxy+zxy+cy;
+	}
+	return maxiter;
+}
+
+//	SIMD version of iter_deep, on BYTES/8 points at once
+//	Each lane has its own position in the orbit, which is gathered
+template <int BYTES> struct vdeep_traits;
+template <> struct vdeep_traits<16> { typedef double vdouble_t __attribute__((vector_size(16))); typedef int64_t vint_t __attribute__((vector_size(16))); };
+template <> struct vdeep_traits<32> { typedef double vdouble_t __attribute__((vector_size(32))); typedef int64_t vint_t __attribute__((vector_size(32))); };
+template <> struct vdeep_traits<64> { typedef double vdouble_t __attribute__((vector_size(64))); typedef int64_t vint_t __attribute__((vector_size(64))); };
+
+template <int BYTES>
+struct vdeep_t
+{
+	typedef typename vdeep_traits<BYTES>::vdouble_t vdouble_t;
+	typedef typename vdeep_traits<BYTES>::vint_t vint_t;
+	static const int LANES = BYTES/sizeof(double);
+
+	//	Built from the loaded values, GCC keeps the lanes in registers
+	//	(built in place: returning a 32 bytes vector from a function without the
+	//	avx2 target is an ABI change GCC warns about)
+	template <size_t... L>
+	static inline __attribute__((always_inline)) void gather( vdouble_t &v, const double *o, const vint_t &m, std::index_sequence<L...> )
+	{
+		v = vdouble_t{ o[m[L]]... };
+	}
+
+	//	A lane that is done takes the next point at once: the counts of a deep
+	//	zoom range over thousands of iterations, and lanes in lockstep would all
+	//	wait for the slowest one
+	static inline __attribute__((always_inline)) void iter_row( const deep_orbit_t &orbit, const double *dcx, double dcy, int n, int maxiter, int *its, uint64_t &rebases )
+	{
+		const vint_t last = vint_t{}+orbit.last();
+		const vint_t vmaxiter = vint_t{}+maxiter;
+		const vdouble_t vdcy = vdouble_t{}+dcy;
+		const double *ox = orbit.x_.data();
+		const double *oy = orbit.y_.data();
+
+		vdouble_t vdcx = {}, dx = {}, dy = {};
+		vint_t m = {};
+		vint_t it = {};
+		vint_t active = {};
+		vint_t rebased = {};
+		int point[LANES];
+		for (int l=0;l!=LANES;l++)
+			point[l] = -1;
+		int next = 0;
+
+		for (;;)
+		{
+			bool all = true;
+			for (int l=0;l!=LANES;l++)
+				all &= active[l]!=0;
+			if (!all)
+			{
+				bool any = false;
+				for (int l=0;l!=LANES;l++)
+				{
+					if (!active[l])
+					{
+						if (point[l]>=0)
+							its[point[l]] = it[l];
+						point[l] = next<n ? next++ : -1;
+						if (point[l]>=0)
+						{
+							vdcx[l] = dcx[point[l]];
+							dx[l] = dy[l] = 0;
+							m[l] = it[l] = 0;
+							active[l] = -1;
+						}
+					}
+					any |= point[l]>=0;
+				}
+				if (!any)
+					break;
+			}
+
+			for (int u=0;u!=DEEP_UNROLL;u++)
+			{
+			vdouble_t zx, zy;
+			gather( zx, ox, m, std::make_index_sequence<LANES>() );
+			gather( zy, oy, m, std::make_index_sequence<LANES>() );
+			vdouble_t ndx = 2*(zx*dx-zy*dy)+(dx*dx-dy*dy)+vdcx;
+			vdouble_t ndy = 2*(zx*dy+zy*dx)+2*dx*dy+vdcy;
+			dx = ndx;
+			dy = ndy;
+			m -= active;
+
+			vdouble_t x, y;
+			gather( x, ox, m, std::make_index_sequence<LANES>() );
+			gather( y, oy, m, std::make_index_sequence<LANES>() );
+			x += dx;
+			y += dy;
+			vdouble_t r2 = x*x+y*y;
+			active &= ~(r2>=DEEP_ESCAPE);
+			it -= active;
+
+			vint_t rebase = active & ((r2<dx*dx+dy*dy) | (m==last));
+			dx = rebase ? x : dx;
+			dy = rebase ? y : dy;
+			m &= ~rebase;
+			rebased -= rebase;
+			active &= it!=vmaxiter;
+			}
+		}
+
+		for (int l=0;l!=LANES;l++)
+			rebases += rebased[l];
+	}
+};
+
+#ifdef __AVX512F__
+void deep_row_avx512( const deep_orbit_t &orbit, const double *dcx, double dcy, int n, int maxiter, int *its, uint64_t &rebases )
+{
+	vdeep_t<64>::iter_row( orbit, dcx, dcy, n, maxiter, its, rebases );
+}
+#endif
+
+#ifdef SIMD_DISPATCH
+__attribute__((target("avx2")))
+void deep_row_avx2( const deep_orbit_t &orbit, const double *dcx, double dcy, int n, int maxiter, int *its, uint64_t &rebases )
+{
+	vdeep_t<32>::iter_row( orbit, dcx, dcy, n, maxiter, its, rebases );
+}
+#endif
+
+void deep_row_sse2( const deep_orbit_t &orbit, const double *dcx, double dcy, int n, int maxiter, int *its, uint64_t &rebases )
+{
+	vdeep_t<16>::iter_row( orbit, dcx, dcy, n, maxiter, its, rebases );
+}
+
+void deep_row_scalar( const deep_orbit_t &orbit, const double *dcx, double dcy, int n, int maxiter, int *its, uint64_t &rebases )
+{
+	for (int k=0;k!=n;k++)
+		its[k] = iter_deep( orbit, dcx[k], dcy, maxiter, rebases );
+}
+
+//	Iterates the n points (dcx[k],dcy) from the orbit center, same results as iter_deep
+void deep_row( const deep_orbit_t &orbit, const double *dcx, double dcy, int n, int maxiter, int *its, uint64_t &rebases )
+{
+	static const auto kernel = []() -> decltype(&deep_row_sse2)
+	{
+#ifdef __AVX512F__
+		return deep_row_avx512;
+#endif
+#ifdef SIMD_DISPATCH
+		if (__builtin_cpu_supports( "avx2" ))
+			return deep_row_avx2;
+#endif
+		return deep_row_sse2;
+	}();
+	kernel( orbit, dcx, dcy, n, maxiter, its, rebases );
+}
+
+struct deep_stats_t
+{
+	uint64_t iterations_ = 0;
+	uint64_t rebases_ = 0;
+	int orbit_ = 0;			//	Length of the reference orbit
+};
+
+//	Iteration counts of a deep place, one reference orbit at its center
+template <typename K=decltype(&deep_row)>
+std::vector<int> deep_render( const deep_place_t &place, int maxiter, deep_stats_t &stats, const tile_pool_t &pool=tile_pool, K kernel=deep_row )
+{
+	deep_orbit_t orbit( place.x_, place.y_, maxiter );
+	std::vector<int> its( place.w_*place.h_ );
+	std::atomic<uint64_t> rebases = 0;
+	render_tiles( place.w_, place.h_, [&]( int i, int j0, int j1 )
+	{
+		std::array<double,TILE_W> dcx;
+		for (int j=j0;j!=j1;j++)
+			dcx[j-j0] = place.dx( j );
+		uint64_t r = 0;
+		kernel( orbit, dcx.data(), place.dy( i ), j1-j0, maxiter, &its[i*place.w_+j0], r );
+		rebases.fetch_add( r, std::memory_order_relaxed );
+	}, pool );
+	stats.rebases_ = rebases;
+	stats.orbit_ = orbit.x_.size();
+	stats.iterations_ = 0;
+	for (int it:its)
+		stats.iterations_ += it;
+	return its;
+}
+
+//	First count drawn as '#' by palette()
+const int PALETTE_SPAN = 42;
+static_assert( palette_table[PALETTE_SPAN-1]!='#' && palette_table[PALETTE_SPAN]=='#' );
+
+//	The counts of a deep zoom spread over thousands of iterations, so each one
+//	is drawn by its rank among the escaping counts of the screen, spread over
+//	the characters of palette()
+class deep_palette_t
+{
+	std::vector<int> escaping_;
+	int maxiter_;
+public:
+	deep_palette_t( const std::vector<int> &its, int maxiter ) : maxiter_(maxiter)
+	{
+		for (int it:its)
+			if (it<maxiter)
+				escaping_.push_back( it );
+		std::sort( escaping_.begin(), escaping_.end() );
+	}
+
+	char operator()( int it ) const
+	{
+		if (it>=maxiter_)
+			return palette( ITER_MAX );
+		int64_t rank = std::lower_bound( escaping_.begin(), escaping_.end(), it )-escaping_.begin();
+		return palette( rank*PALETTE_SPAN/escaping_.size() );
+	}
+};
+
+deep_stats_t mandel_deep( const deep_place_t &place, int maxiter, ioutput &out, const tile_pool_t &pool=tile_pool )
+{
+	std::cout << place.description() << "\n";
+	deep_stats_t stats;
+	auto its = deep_render( place, maxiter, stats, pool );
+	deep_palette_t deep_palette( its, maxiter );
+
+	out.output_start( place.description(), place.w_, place.h_ );
+	for (int i=0;i!=place.h_;i++)
+		for (int j=0;j!=place.w_;j++)
+			out.output( deep_palette( its[i*place.w_+j] ),
+				fixed_t( (float)(place.x_.hi_+place.dx( j )) ), fixed_t( (float)(place.y_.hi_+place.dy( i )) ) );
+	out.output_end();
+	return stats;
+}
+
+void print_deep_stats( const deep_stats_t &stats )
+{
+	std::cout << "Deep: " << stats.iterations_ << " iterations, orbit of " << stats.orbit_ << ", " << stats.rebases_ << " rebases" << std::endl;
+}
+
+//	Checks the double-double numbers, and the perturbation against direct
+//	double-double iterations at a zoom far past the double epsilon of the center
+void test_deep()
+{
+	dd_t v;
+	assert( dd_t::parse( DEEP_X, v ) );
+	assert( v.to_string( 30 )=="-0.743643887037158704752191506114" );
+	assert( dd_t::parse( "15e-1", v ) && v.hi_==1.5 && v.lo_==0 );
+	assert( !dd_t::parse( "1.5x", v ) && !dd_t::parse( "", v ) && !dd_t::parse( "1e", v ) );
+	dd_t e = dd_t( 1 )+dd_t( 1.0/(1ull<<60) );
+	assert( e.hi_==1 && e.lo_==1.0/(1ull<<60) );
+	assert( (e*e-dd_t( 1 )).hi_==2.0/(1ull<<60) );
+	assert( (dd_t( 1 )/3.0*3.0-dd_t( 1 )).hi_==0 );
+
+	//	p1 is the same place as a deep place
+	place_t p1(-0.61,0,19,24);
+	deep_place_t d1( p1 );
+	assert( d1.x_.hi_+d1.dx( 0 )==p1.x_.to_float() && d1.y_.hi_+d1.dy( 0 )==p1.y_.to_float() );
+
+	//	The counts of this place range from about 1200 to MAXITER
+	const int MAXITER=2000;
+	dd_t x, y;
+	dd_t::parse( DEEP_X, x );
+	dd_t::parse( DEEP_Y, y );
+	deep_place_t deep( x, y, 1e-12, 1e-12 );
+	deep_stats_t stats;
+	auto its = deep_render( deep, MAXITER, stats, tile_pool, deep_row_scalar );
+	int mismatches = 0;
+	for (int i=0;i!=deep.h_;i++)
+		for (int j=0;j!=deep.w_;j++)
+			mismatches += its[i*deep.w_+j]!=iter_dd( deep.x_+dd_t( deep.dx( j ) ), deep.y_+dd_t( deep.dy( i ) ), MAXITER );
+	assert( mismatches*100<=deep.w_*deep.h_ );
+	assert( stats.rebases_>0 );
+
+	std::vector<decltype(&deep_row)> kernels = { deep_row, deep_row_sse2 };
+#ifdef SIMD_DISPATCH
+	if (__builtin_cpu_supports( "avx2" ))
+		kernels.push_back( deep_row_avx2 );
+#endif
+	for (auto kernel:kernels)
+	{
+		deep_stats_t s;
+		assert( deep_render( deep, MAXITER, s, tile_pool, kernel )==its );
+		assert( s.rebases_==stats.rebases_ );
+	}
+}
+
+//	Records everything sent to the output, to compare renders
+class capture_output : public ioutput
+{
+public:
+	std::string data_;
+
+	virtual void do_output_start( const std::string s )
+	{
+		data_ += s + "\n";
+	}
+
+	virtual void do_output( char c, fixed_t fx, fixed_t fy )
+	{
+		data_ += c;
+		data_ += fx.as_asm("","") + fy.as_asm("","");
+	}
+};
+
+//	Checks the best character table against the linear search
+void test_font( const font_t &font )
+{
+	std::vector<uint8_t> i0, i1, i2, i3;
+	for (int a=0;a<=ITER_MAX;a+=3)
+		for (int b=0;b<=ITER_MAX;b+=7)
+		{
+			int c = (a+b)%(ITER_MAX+1);
+			int d = (a*b)%(ITER_MAX+1);
+			assert( font.best( a, b, c, d ) == font.scan( font_t::level( a ), font_t::level( b ), font_t::level( c ), font_t::level( d ) ) );
+			i0.push_back( a ); i1.push_back( b ); i2.push_back( c ); i3.push_back( d );
+		}
+	std::vector<char> chars( i0.size() );
+	font.best_row( i0.data(), i1.data(), i2.data(), i3.data(), i0.size(), chars.data() );
+	for (int k=0;k!=i0.size();k++)
+		assert( chars[k] == font.best( i0[k], i1[k], i2[k], i3[k] ) );
+}
+
+//	Checks that the multithreaded renders are identical to the serial ones
+void test_render( const font_t &font )
+{
+	tile_pool_t pool4( 4 );
+	escape_map_t map( nullptr, pool4 );
+	place_t places[] = { place_t(-0.61,0,19,24), place_t(-1.04,-0.33,1,1), place_t(0,0,8,8,130,70) };
+	for (auto &place:places)
+	{
+		capture_output s, m;
+		mandel<packed_t>( place, s );
+		mandel_mt<packed_t>( place, m, pool4 );
+		assert( s.data_ == m.data_ );
+
+		s.data_.clear(); m.data_.clear();
+		mandelhr<packed_t>( place, s, font );
+		mandelhr_mt<packed_t>( place, m, font, pool4 );
+		assert( s.data_ == m.data_ );
+
+		//	Adaptive sampling gives nearly the glyphs of 4x4 samples everywhere, with fewer samples
+		s.data_.clear(); m.data_.clear();
+		auto full = mandelhr_adaptive<packed_t>( place, s, font, true, pool4 );
+		auto adaptive = mandelhr_adaptive<packed_t>( place, m, font, false, pool4 );
+		assert( full.samples_ == 16*place.w_*place.h_ && full.cells_[2] == place.w_*place.h_ );
+		assert( adaptive.iterations_*2 < full.iterations_ );
+		int diff = 0;
+		for (size_t k=0;k!=s.data_.size();k++)
+			diff += s.data_[k]!=m.data_[k];
+		assert( diff*20 <= place.w_*place.h_ );
+
+		s.data_.clear(); m.data_.clear();
+		julia<packed_t>( place, -0.8, 0.156, s );
+		julia_mt<packed_t>( place, -0.8, 0.156, m, pool4 );
+		assert( s.data_ == m.data_ );
+
+		s.data_.clear(); m.data_.clear();
+		mandel_mt<packed_t>( place, s, pool4 );
+		mandel_map<packed_t>( place, m, map );
+		assert( s.data_ == m.data_ );
+
+		//	Mariani-Silver is approximate, but exact on these
+		s.data_.clear(); m.data_.clear();
+		mandel_mt<packed_t>( place, s, pool4 );
+		auto stats = mandel_ms<packed_t>( place, m, true, pool4 );
+		assert( stats.computed_+stats.avoided_ == place.w_*place.h_ );
+		assert( stats.mismatches_ == 0 );
+		assert( s.data_ == m.data_ );
+
+		s.data_.clear(); m.data_.clear();
+		julia_mt<packed_t>( place, -0.8, 0.156, s, pool4 );
+		stats = julia_ms<packed_t>( place, -0.8, 0.156, m, true, pool4 );
+		assert( stats.computed_+stats.avoided_ == place.w_*place.h_ );
+		assert( stats.mismatches_ == 0 );
+		assert( s.data_ == m.data_ );
+	}
+
+	//	A single border check fills 3 points of this julia wrongly
+	{
+		place_t place( 0,0,4,4,256,256 );
+		capture_output s, m, v;
+		julia_mt<packed_t>( place, -0.8, 0.156, s, pool4 );
+		auto stats = julia_ms<packed_t>( place, -0.8, 0.156, m, false, pool4 );
+		assert( stats.avoided_>0 && s.data_ == m.data_ );
+		julia_ms<packed_t>( place, -0.8, 0.156, v, true, pool4 );
+		assert( s.data_ == v.data_ );
+	}
+
+	//	Zooms reuse a quarter of the points of the previous frame
+	zoom_frame_t mandel_frame, julia_frame, infer_frame;
+	for (int i=16;i!=0;i/=2)
+	{
+		place_t place( -1.04,-0.33,i,i,256/i,128/i );
+		capture_output s, m;
+		mandel_mt<packed_t>( place, s, pool4 );
+		auto stats = mandel_zoom<packed_t>( place, m, mandel_frame, false, pool4 );
+		assert( s.data_ == m.data_ );
+		assert( stats.reused_ == (i==16 ? 0 : place.w_*place.h_/4) );
+		assert( stats.reused_+stats.computed_ == place.w_*place.h_ );
+
+		s.data_.clear(); m.data_.clear();
+		julia_mt<packed_t>( place, -0.8, 0.156, s, pool4 );
+		julia_zoom<packed_t>( place, -0.8, 0.156, m, julia_frame, false, pool4 );
+		assert( s.data_ == m.data_ );
+
+		//	Mariani-Silver is exact on this one too
+		s.data_.clear(); m.data_.clear();
+		julia_mt<packed_t>( place, -0.8, 0.156, s, pool4 );
+		stats = julia_zoom<packed_t>( place, -0.8, 0.156, m, infer_frame, true, pool4 );
+		assert( s.data_ == m.data_ );
+		assert( stats.reused_+stats.computed_+stats.avoided_ == place.w_*place.h_ );
+	}
+}
+
+//	-----------------------------------------------------------------------------
+//	Exact C++ model of the ASM code
+//	-----------------------------------------------------------------------------
+
+//	Mirror of the per zoom level ASM tables (MAXITER, ZOOMTRIGGERMIN, ZOOMTRIGGERMAX, PALETTE)
+struct zoomlevel_t
+{
+	int maxiter_;
+	int triggermin_;
+	int triggermax_;
+	const char *palette_;
+};
+
+const int ZOOMLEVELS=5;
+
+constexpr zoomlevel_t zoomlevels[ZOOMLEVELS] =
+{
+	{ 19, 15, 20, "..,'~=+:;[/<*?&O0X# " },
+	{ 24, 17, 20, "..,'~==+:;;[[/<*??&OO0X# " },
+	{ 29, 18, 21, "..,''~==++::;;[[/<<**??&OO0X# " },
+	{ 34, 19, 22, "..,''~~==+++::;;[[/<<**??&&OO00XX# " },
+	{ 39, 20, 23, "..,''~~==+++:::;;;[[[//<<***??&&OO00XX# " },
+};
+
+//	Each palette has one character per count, up to MAXITER, and they all fit in
+//	the 256 bytes PALETTEDELTA can address
+static_assert( []()
+{
+	int total = 0;
+	for (auto &level:zoomlevels)
+	{
+		int n = 0;
+		while (level.palette_[n])
+			if (level.palette_[n++]=='"')
+				return false;
+		if (n!=level.maxiter_+1)
+			return false;
+		total += n;
+	}
+	return total<=256;
+}() );
+
+template <size_t... ZOOM>
+constexpr std::array<palette_lut_t,ZOOMLEVELS> make_zoom_palettes( std::index_sequence<ZOOM...> )
+{
+	return { palette_lut_t( zoomlevels[ZOOM].palette_, zoomlevels[ZOOM].maxiter_+1 )... };
+}
+
+//	The palettes as tables for palette_row
+constexpr auto zoom_palettes = make_zoom_palettes( std::make_index_sequence<ZOOMLEVELS>() );
+
+//	Calls f with std::integral_constant<int,zoom>, so each zoom level gets its own
+//	instance of f, specialised on the constexpr table entries
+template <typename F, int... ZOOM>
+auto with_zoomlevel( int zoom, F f, std::integer_sequence<int,ZOOM...> )
+{
+	decltype(f( std::integral_constant<int,0>() )) r;
+	assert( zoom>=0 && zoom<ZOOMLEVELS );
+	((zoom==ZOOM && (r = f( std::integral_constant<int,ZOOM>() ), true)) || ...);
+	return r;
+}
+
+template <typename F>
+auto with_zoomlevel( int zoom, F f )
+{
+	return with_zoomlevel( zoom, f, std::make_integer_sequence<int,ZOOMLEVELS>() );
+}
+
+const int SCREENWIDTH=40;
+const int SCREENHEIGHT=24;
+
+//	A place as the ASM stores it (X0, Y0, DX, DY, ZOOMLEVEL)
+struct asm_place_t
+{
+	uint16_t x_;
+	uint16_t y_;
+	uint16_t dx_;
+	uint16_t dy_;
+	int zoom_;
+
+	//	INITIALPLACE
+	static asm_place_t initial()
+	{
+		return { 0xFBD0, 0xFDC0, 0x0026, 0x0030, 0 };
+	}
+};
+
+//	The ASM SQUARE routine, on a 16 bits AX value
+//	Returns false (carry set) on overflow
+inline bool square_asm( uint16_t v, uint16_t &sq )
+{
+	if (v & 0x8000)
+		v = -v;
+	if ((v >> 8) >= 0x10)
+		return false;
+	sq = squaretable[v >> 1];
+	return !(sq & 1);
+}
+
+//	The ASM ITER routine: 16 bits wrapping additions, and stops as soon as a square overflows
+int iter_asm( uint16_t x, uint16_t y, int maxiter )
+{
+	uint16_t zx = x, zy = y, zx2, zy2, t;
+	int it = 0;
+
+	if (!square_asm( zx, zx2 ) || !square_asm( zy, zy2 ))
+		return 0;
+
+	for (;;)
+	{
+		//	MANDEL1
+		if (!square_asm( zx - zy, t ))
+			return it;
+		zy = -t + zx2 + zy2 + y;
+		zx = -zy2 + zx2 + x;
+		if (!square_asm( zx, zx2 ) || !square_asm( zy, zy2 ))
+			return it;
+
+		it = (it + 1) & 0xff;
+		if (it == maxiter)
+			return it;
+	}
+}
+
+//	iter_asm for a MAXITER known at compile time
+//	(below 256, so the count does not need to wrap)
+template <int MAXITER>
+int iter_asm( uint16_t x, uint16_t y )
+{
+	static_assert( MAXITER>0 && MAXITER<256 );
+	uint16_t zx = x, zy = y, zx2, zy2, t;
+
+	if (!square_asm( zx, zx2 ) || !square_asm( zy, zy2 ))
+		return 0;
+
+#pragma GCC unroll 8
+	for (int it=0;it!=MAXITER;it++)
+	{
+		if (!square_asm( zx - zy, t ))
+			return it;
+		zy = -t + zx2 + zy2 + y;
+		zx = -zy2 + zx2 + x;
+		if (!square_asm( zx, zx2 ) || !square_asm( zy, zy2 ))
+			return it;
+	}
+	return MAXITER;
+}
+
+//	Checks the specialised iter_asm of each zoom level against the generic one
+void test_iter_asm()
+{
+	for (int zoom=0;zoom!=ZOOMLEVELS;zoom++)
+		with_zoomlevel( zoom, [&]( auto z )
+		{
+			constexpr int maxiter = zoomlevels[z].maxiter_;
+			for (int y=-0x1000;y<=0x1000;y+=6)
+				for (int x=-0x1000;x<=0x1000;x+=10)
+					assert( iter_asm<maxiter>( x, y )==iter_asm( x, y, maxiter ) );
+			return 0;
+		} );
+}
+
+//	The characters DRAWSET displays for a place
+//	(the last one is not displayed, to avoid scrolling)
+std::string drawset_model( const asm_place_t &place )
+{
+	return with_zoomlevel( place.zoom_, [&]( auto zoom )
+	{
+		constexpr zoomlevel_t level = zoomlevels[zoom];
+		std::string s( SCREENWIDTH*SCREENHEIGHT, ' ' );
+		uint8_t its[SCREENWIDTH];
+		uint16_t y = place.y_;
+		for (int i=0;i!=SCREENHEIGHT;i++)
+		{
+			uint16_t x = place.x_;
+			for (int j=0;j!=SCREENWIDTH;j++)
+			{
+				its[j] = iter_asm<level.maxiter_>( x, y );
+				x += place.dx_;
+			}
+			palette_row( zoom_palettes[zoom], its, SCREENWIDTH, &s[i*SCREENWIDTH] );
+			y += place.dy_;
+		}
+		s.pop_back();
+		return s;
+	} );
+}
+
+//	The ASM SELECTNEXT: the place one zoom level in, centered on the pixel at (x,y)
+//	Returns false when the zoom is too high (a halved delta would be 1)
+bool select_next_model( const asm_place_t &place, uint16_t x, uint16_t y, asm_place_t &next )
+{
+	//	CMP #$80 ROR: arithmetic shift of the LSB only
+	auto half = []( uint16_t d, uint16_t &h )
+	{
+		uint8_t lsb = (d & 0xff) >> 1 | (d & 0x80);
+		h = (d & 0xff00) | (lsb & 0xfe);
+		return lsb!=1;
+	};
+	//	NEXTDX is already written when DY is too high
+	uint16_t dx, dy;
+	if (!half( place.dx_, dx ))
+		return false;
+	next.dx_ = dx;
+	if (!half( place.dy_, dy ))
+		return false;
+	next.dy_ = dy;
+	next.x_ = x - SCREENWIDTH/2*next.dx_;
+	next.y_ = y - SCREENHEIGHT/2*next.dy_;
+	next.zoom_ = place.zoom_+1;
+	return true;
+}
+
+//	The reuse map of a zoom from place to next, on the 16 bits coordinates of DRAWSET
+reuse_map_t reuse_map_model( const asm_place_t &place, const asm_place_t &next )
+{
+	auto axis = []( uint16_t v, uint16_t d, int n )
+	{
+		std::vector<uint16_t> vs;
+		for (int k=0;k!=n;k++)
+			vs.push_back( v+k*d );
+		return vs;
+	};
+	return reuse_map_t( axis( place.x_, place.dx_, SCREENWIDTH ), axis( place.y_, place.dy_, SCREENHEIGHT ),
+		axis( next.x_, next.dx_, SCREENWIDTH ), axis( next.y_, next.dy_, SCREENHEIGHT ) );
+}
+
+//	The ASM RANDOM: 8 bits LFSR, 255 values for a non zero seed
+inline uint8_t random_asm( uint8_t &seed )
+{
+	seed = seed & 0x80 ? (uint8_t)(seed << 1) ^ 0x1d : (uint8_t)(seed << 1);
+	return seed;
+}
+
+//	The ASM RNDCHOICE: a RANDOM count (256 for 0) of FREQ down counts, true if it ends on 1
+inline bool rndchoice_asm( uint8_t freq, uint8_t &seed )
+{
+	uint8_t x = freq;
+	uint8_t y = random_asm( seed );
+	do
+	{
+		if (--x==0)
+			x = freq;
+	} while (--y);
+	return x==1;
+}
+
+//	One DRAWSET of MANDELAUTO, without key presses
+struct demo_screen_t
+{
+	asm_place_t place_;
+	std::string chars_;		//	As drawset_model
+	asm_place_t next_;		//	NEXTX... after DRAWSET: INITIALPLACE if nothing was selected
+	uint8_t seed_;			//	SEED after DRAWSET
+	int iterations_;		//	Sum of the ITER counts of the screen
+};
+
+//	DRAWSET with its SELECTNEXT calls, 1/FREQ times on the FREQth candidate
+demo_screen_t demo_screen_model( const asm_place_t &place, uint8_t seed )
+{
+	demo_screen_t screen = { place, std::string( SCREENWIDTH*SCREENHEIGHT, ' ' ), asm_place_t::initial(), seed, 0 };
+	with_zoomlevel( place.zoom_, [&]( auto zoom )
+	{
+		constexpr zoomlevel_t level = zoomlevels[zoom];
+		uint8_t freq = 0;
+		uint8_t its[SCREENWIDTH];
+		uint16_t y = place.y_;
+		for (int i=0;i!=SCREENHEIGHT;i++)
+		{
+			uint16_t x = place.x_;
+			for (int j=0;j!=SCREENWIDTH;j++)
+			{
+				int it = its[j] = iter_asm<level.maxiter_>( x, y );
+				screen.iterations_ += it;
+				//	DRAWSET iterates the last cell, then stops before its character and SELECTNEXT
+				if (i==SCREENHEIGHT-1 && j==SCREENWIDTH-1)
+					break;
+				if (it>=level.triggermin_ && it<level.triggermax_ && rndchoice_asm( ++freq, screen.seed_ ))
+					select_next_model( place, x, y, screen.next_ );
+				x += place.dx_;
+			}
+			palette_row( zoom_palettes[zoom], its, i==SCREENHEIGHT-1 ? SCREENWIDTH-1 : SCREENWIDTH, &screen.chars_[i*SCREENWIDTH] );
+			y += place.dy_;
+		}
+		return 0;
+	} );
+	screen.chars_.pop_back();
+	return screen;
+}
+
+//	Checks the random functions and that the demo zooms in and restarts
+void test_demo_model()
+{
+	std::set<uint8_t> values;
+	uint8_t seed = 1;
+	for (int k=0;k!=255;k++)
+		values.insert( random_asm( seed ) );
+	assert( seed==1 && values.size()==255 && !values.count( 0 ) );
+
+	//	The first candidate is always taken, the second half of the times
+	int seconds = 0;
+	for (int s=1;s!=256;s++)
+	{
+		seed = s;
+		assert( rndchoice_asm( 1, seed ) );
+		seconds += rndchoice_asm( 2, seed );
+	}
+	assert( seconds>=96 && seconds<=160 );
+
+	auto place = asm_place_t::initial();
+	seed = 1;
+	for (int k=0;k!=ZOOMLEVELS;k++)
+	{
+		auto screen = demo_screen_model( place, seed );
+		assert( screen.chars_==drawset_model( place ) );
+		assert( screen.next_.zoom_==(k+1)%ZOOMLEVELS );
+		place = screen.next_;
+		seed = screen.seed_;
+	}
+}
+
+//	Prints the zoom level palettes as ASM data, packed one after the other
+int palette_main()
+{
+	std::cout << "; Palettes generated by 'validate palette'" << std::endl;
+	std::cout << "PALETTE:" << std::endl;
+	for (auto &level:zoomlevels)
+		std::cout << "\t.byte \"" << level.palette_ << "\"" << std::endl;
+	std::cout << "PALETTEDELTA:" << std::endl << "\t.byte ";
+	int delta = 0;
+	for (int zoom=0;zoom!=ZOOMLEVELS;zoom++)
+	{
+		std::cout << (zoom ? ", " : "") << delta;
+		delta += zoomlevels[zoom].maxiter_+1;
+	}
+	std::cout << std::endl << "MAXITER:" << std::endl << "\t.byte ";
+	for (int zoom=0;zoom!=ZOOMLEVELS;zoom++)
+		std::cout << (zoom ? ", " : "") << zoomlevels[zoom].maxiter_;
+	std::cout << std::endl;
+	return 0;
+}
+
+//	-----------------------------------------------------------------------------
+//	6502 emulation
+//	-----------------------------------------------------------------------------
+
+//	Addresses in mandelbrot65.o65 (V1.1, as committed)
+struct symbol_t
+{
+	const char *name_;
+	uint16_t adrs_;
+};
+
+const symbol_t default_symbols[] =
+{
+	//	Code
+	{ "START", 0x0280 }, { "PALETTE", 0x0375 }, { "PALETTEDELTA", 0x043D }, { "MAXITER", 0x0442 },
+	{ "ZOOMTRIGGERMIN", 0x0447 }, { "ZOOMTRIGGERMAX", 0x044C }, { "MAIN", 0x0451 },
+	{ "MANDELAUTO", 0x0559 }, { "PRINTINLINE", 0x0577 }, { "INITIALPLACE", 0x05A5 },
+	{ "GOTOPLACE", 0x05CA }, { "WAIT", 0x05EF }, { "KEYPRESSED", 0x0617 }, { "DRAWSET", 0x0629 },
+	{ "SELECTNEXT", 0x0697 }, { "RNDCHOICE", 0x06FD }, { "RANDOM", 0x070E }, { "INCPTR", 0x0718 },
+	{ "ITER", 0x0720 }, { "MANDEL1", 0x0757 }, { "CHARFROMIT", 0x07C9 }, { "SQUARE", 0x07D6 },
+	{ "ABS", 0x07F3 }, { "NEG", 0x07F8 }, { "FILLSQUARES", 0x0806 }, { "END", 0x08A6 },
+
+	//	Apple1
+	{ "PRBYTE", 0xFFDC }, { "ECHO", 0xFFEF }, { "KBD", 0xD010 }, { "KBDCR", 0xD011 },
+
+	//	Zero page
+	{ "X0", 0x00 }, { "Y0", 0x02 }, { "DX", 0x04 }, { "DY", 0x06 }, { "ZOOMLEVEL", 0x08 },
+	{ "FREQ", 0x09 }, { "SEED", 0x0D }, { "ABORT", 0x0E }, { "IT", 0x0F },
+	{ "NEXTX", 0x10 }, { "NEXTY", 0x12 }, { "NEXTDX", 0x14 }, { "NEXTDY", 0x16 }, { "NEXTZOOMLEVEL", 0x18 },
+	{ "X", 0x20 }, { "Y", 0x22 }, { "SCRNX", 0x24 }, { "SCRNY", 0x26 },
+	{ "ZX", 0x28 }, { "ZY", 0x2A }, { "ZX2", 0x2C }, { "ZY2", 0x2E },
+	{ "NUM", 0x30 }, { "INCR", 0x33 }, { "PTR", 0x36 },
+};
+
+class symbols_t
+{
+public:
+	struct label_t
+	{
+		std::string name_;
+		uint16_t adrs_;
+	};
+
+private:
+	std::vector<label_t> symbols_;
+
+	static bool is_mnemonic( const std::string &s )
+	{
+		static const char *mnemonics[] =
+		{
+			"ADC","AND","ASL","BCC","BCS","BEQ","BIT","BMI","BNE","BPL","BRK","BVC","BVS","CLC",
+			"CLD","CLI","CLV","CMP","CPX","CPY","DEC","DEX","DEY","EOR","INC","INX","INY","JMP",
+			"JSR","LDA","LDX","LDY","LSR","NOP","ORA","PHA","PHP","PLA","PLP","ROL","ROR","RTI",
+			"RTS","SBC","SEC","SED","SEI","STA","STX","STY","TAX","TAY","TSX","TXA","TXS","TYA"
+		};
+		for (auto m:mnemonics)
+			if (!strcasecmp( m, s.c_str() ))
+				return true;
+		return false;
+	}
+
+	//	Parses a "$hex", "%bin", decimal or "*" value
+	static bool parse_value( const std::string &s, int pc, int &v )
+	{
+		char *end;
+		if (s=="*")
+			v = pc;
+		else if (s.size()>1 && s[0]=='$')
+			v = strtol( s.c_str()+1, &end, 16 );
+		else if (s.size()>1 && s[0]=='%')
+			v = strtol( s.c_str()+1, &end, 2 );
+		else if (isdigit( s[0] ))
+			v = strtol( s.c_str(), &end, 10 );
+		else
+			return false;
+		return s=="*" || *end==0;
+	}
+
+public:
+	symbols_t()
+	{
+		for (auto &s:default_symbols)
+			symbols_.push_back( { s.name_, s.adrs_ } );
+	}
+
+	//	Reads the labels and equates from a xa listing (xa -P)
+	//	Labels inside a .( .) block are named OWNER.LABEL
+	//	Returns false, with a warning, if the file cannot be read or holds no symbols,
+	//	leaving the default symbols
+	bool load_lst( const char *name )
+	{
+		std::ifstream ifs( name );
+		if (!ifs)
+		{
+			std::cerr << "Cannot read " << name << ", using the V1.1 addresses" << std::endl;
+			return false;
+		}
+
+		std::vector<std::pair<std::string,int>> found;
+		std::string line, owner;
+		int depth = 0;
+		while (std::getline( ifs, line ))
+		{
+			//	"  LINE A:PC  BYTES...  SOURCE"
+			auto p = line.find( "A:" );
+			if (p==std::string::npos || p+6>line.size() || !isxdigit( line[p+2] ))
+				continue;
+			int pc = strtol( line.substr( p+2, 4 ).c_str(), nullptr, 16 );
+			std::istringstream iss( line.substr( p+6 ) );
+			std::vector<std::string> tokens;
+			std::string t;
+			while (iss >> t && t[0]!=';')
+				tokens.push_back( t );
+			size_t i = 0;
+			while (i<tokens.size() && tokens[i].size()==2 && isxdigit( tokens[i][0] ) && isxdigit( tokens[i][1] ))
+				i++;
+			if (i==tokens.size())
+				continue;
+
+			if (tokens[i]==".(")
+			{
+				depth++;
+				continue;
+			}
+			if (tokens[i]==".)")
+			{
+				depth--;
+				continue;
+			}
+
+			//	Splits "NAME=VALUE", "NAME = VALUE" and "NAME:"
+			std::string rest;
+			for (size_t j=i;j!=tokens.size();j++)
+				rest += tokens[j] + " ";
+			size_t n = 0;
+			while (n<rest.size() && (isalnum( rest[n] ) || rest[n]=='_'))
+				n++;
+			if (n==0 || isdigit( rest[0] ))
+				continue;
+			std::string label = rest.substr( 0, n );
+			while (n<rest.size() && (rest[n]==' ' || rest[n]==':'))
+				n++;
+
+			int v;
+			if (n<rest.size() && rest[n]=='=')
+			{
+				std::istringstream value( rest.substr( n+1 ) );
+				std::string s;
+				value >> s;
+				if (parse_value( s, pc, v ))
+					found.push_back( { label, v & 0xffff } );
+			}
+			else if (!is_mnemonic( label ) && (rest[n-1]==':' || rest[n-1]==' '))
+			{
+				if (depth==0)
+				{
+					owner = label;
+					found.push_back( { label, pc } );
+				}
+				else
+					found.push_back( { owner+"."+label, pc } );
+			}
+		}
+
+		if (found.empty())
+		{
+			std::cerr << "No symbols in " << name << ", using the V1.1 addresses" << std::endl;
+			return false;
+		}
+		symbols_.clear();
+		for (auto &f:found)
+			symbols_.push_back( { f.first, (uint16_t)f.second } );
+		return true;
+	}
+
+	uint16_t operator[]( const std::string &name ) const
+	{
+		for (auto &s:symbols_)
+			if (!strcasecmp( name.c_str(), s.name_.c_str() ))
+				return s.adrs_;
+		std::cerr << "Unknown symbol " << name << std::endl;
+		exit(1);
+	}
+
+	//	Name of the routine at adrs, or its address in hex
+	std::string name( uint16_t adrs ) const
+	{
+		for (auto &s:symbols_)
+			if (s.adrs_==adrs && adrs>=0x100)
+				return s.name_;
+		char buffer[8];
+		sprintf( buffer, "$%04X", adrs );
+		return buffer;
+	}
+
+	//	Labels between from and to, sorted by address
+	std::vector<label_t> labels( uint16_t from, uint16_t to ) const
+	{
+		std::vector<label_t> res;
+		for (auto &s:symbols_)
+			if (s.adrs_>=from && s.adrs_<to)
+				res.push_back( s );
+		std::stable_sort( res.begin(), res.end(), []( auto &a, auto &b ){ return a.adrs_<b.adrs_; } );
+		return res;
+	}
+};
+
+//	A NMOS 6502 with the Apple1 keyboard and display
+//	Cycle exact, including page crossings, taken branches and decimal mode
+class cpu6502_t
+{
+public:
+	static const uint16_t KBD=0xD010;
+	static const uint16_t KBDCR=0xD011;
+	static const uint16_t PRBYTE=0xFFDC;
+	static const uint16_t ECHO=0xFFEF;
+
+	//	Where call() returns (inside the monitor ROM, which is not emulated)
+	static const uint16_t CALL_RETURN=0xFF01;
+
+	//	BIT DSP + BMI + STA DSP (waiting for the display is not modelled)
+	static const int ECHO_CYCLES=10;
+
+	enum { FC=0x01, FZ=0x02, FI=0x04, FD=0x08, FB=0x10, FU=0x20, FV=0x40, FN=0x80 };
+
+	uint8_t a_ = 0;
+	uint8_t x_ = 0;
+	uint8_t y_ = 0;
+	uint8_t s_ = 0xFF;
+	uint8_t p_ = FU | FI;
+	uint16_t pc_ = 0;
+	uint64_t cycles_ = 0;
+	bool halted_ = false;
+
+	std::vector<uint8_t> mem_;
+
+	//	Keys to type, with the cycle at which they are pressed
+	std::deque<std::pair<uint64_t,uint8_t>> keys_;
+
+	//	Everything sent to ECHO
+	std::string output_;
+
+	//	Inclusive cycles of each subroutine (from its JSR to its RTS), if tracked
+	struct routine_t
+	{
+		uint64_t calls_ = 0;
+		uint64_t cycles_ = 0;
+	};
+	std::vector<routine_t> routines_;
+
+	//	Cycles spent on each instruction, whether it read the square table
+	//	and cycle count at each ECHO, if profiling
+	std::vector<uint64_t> pc_cycles_;
+	std::vector<uint8_t> pc_table_;
+	std::vector<uint64_t> output_cycles_;
+
+private:
+	uint16_t op_pc_ = 0;
+
+	struct frame_t
+	{
+		uint16_t adrs_;
+		uint64_t start_;
+	};
+	std::vector<frame_t> frames_;
+
+public:
+	cpu6502_t() : mem_(0x10000) {}
+
+	void load( const char *name, uint16_t adrs )
+	{
+		FILE *f = fopen(name, "rb");
+		if (f==nullptr)
+		{
+			std::cerr << "Cannot open file " << name << std::endl;
+			exit(1);
+		}
+		size_t n = fread(mem_.data()+adrs, 1, mem_.size()-adrs, f);
+		fclose(f);
+		if (n==0)
+		{
+			std::cerr << "Cannot read file " << name << std::endl;
+			exit(1);
+		}
+	}
+
+	void track_routines( bool track )
+	{
+		routines_.clear();
+		frames_.clear();
+		if (track)
+			routines_.resize( 0x10000 );
+	}
+
+	void profile( bool on )
+	{
+		pc_cycles_.assign( on ? 0x10000 : 0, 0 );
+		pc_table_.assign( on ? 0x10000 : 0, 0 );
+		output_cycles_.clear();
+	}
+
+	uint16_t get16( uint16_t adrs ) const
+	{
+		return mem_[adrs] | (mem_[(adrs+1)&0xffff] << 8);
+	}
+
+	void set16( uint16_t adrs, uint16_t v )
+	{
+		mem_[adrs] = v;
+		mem_[(adrs+1)&0xffff] = v >> 8;
+	}
+
+	//	The characters displayed on the Apple1 40x24 screen
+	std::vector<std::string> screen() const
+	{
+		std::vector<std::string> lines(1);
+		for (auto c:output_)
+		{
+			if (c=='\r')
+				lines.push_back( "" );
+			else
+			{
+				if (lines.back().size()==SCREENWIDTH)
+					lines.push_back( "" );
+				lines.back() += c;
+			}
+		}
+		if (lines.size()>SCREENHEIGHT)
+			lines.erase( lines.begin(), lines.end()-SCREENHEIGHT );
+		return lines;
+	}
+
+	//	Calls the subroutine at adrs, as a JSR would, and returns the cycles spent
+	//	Stops after max_cycles
+	uint64_t call( uint16_t adrs, uint64_t max_cycles=UINT64_MAX )
+	{
+		uint64_t start = cycles_;
+		push16( CALL_RETURN-1 );
+		enter( adrs );
+		pc_ = adrs;
+		cycles_ += 6;
+		while (pc_!=CALL_RETURN && !halted_ && cycles_-start<max_cycles)
+			step();
+		return cycles_-start;
+	}
+
+	//	Runs from the current PC
+	void run( uint64_t max_cycles )
+	{
+		uint64_t start = cycles_;
+		while (!halted_ && cycles_-start<max_cycles)
+			step();
+	}
+
+private:
+	uint8_t read( uint16_t adrs )
+	{
+		if ((adrs & 0xfffe)==KBD)
+		{
+			bool ready = !keys_.empty() && keys_.front().first<=cycles_;
+			if (adrs==KBDCR)
+				return ready ? 0x80 : 0x00;
+			if (!ready)
+				return 0x80;
+			uint8_t key = keys_.front().second;
+			keys_.pop_front();
+			return key | 0x80;
+		}
+		if ((adrs >> 12)==1 && !pc_table_.empty())
+			pc_table_[op_pc_] = 1;
+		return mem_[adrs];
+	}
+
+	void write( uint16_t adrs, uint8_t v )
+	{
+		mem_[adrs] = v;
+	}
+
+	void push( uint8_t v )
+	{
+		mem_[0x100 | s_--] = v;
+	}
+
+	uint8_t pull()
+	{
+		return mem_[0x100 | ++s_];
+	}
+
+	void push16( uint16_t v )
+	{
+		push( v >> 8 );
+		push( v );
+	}
+
+	uint16_t pull16()
+	{
+		uint16_t v = pull();
+		return v | (pull() << 8);
+	}
+
+	void enter( uint16_t adrs )
+	{
+		if (!routines_.empty())
+			frames_.push_back( { adrs, cycles_ } );
+	}
+
+	//	Called after the RTS cycles are counted
+	void leave()
+	{
+		if (!frames_.empty())
+		{
+			auto &r = routines_[frames_.back().adrs_];
+			r.calls_++;
+			r.cycles_ += cycles_-frames_.back().start_;
+			frames_.pop_back();
+		}
+	}
+
+	void rts()
+	{
+		pc_ = pull16()+1;
+		cycles_ += 6;
+		leave();
+	}
+
+	//	Monitor ROM entry points
+	void trap()
+	{
+		switch (pc_)
+		{
+			case ECHO:
+				output_ += (char)(a_ & 0x7f);
+				cycles_ += ECHO_CYCLES;
+				if (!pc_cycles_.empty())
+					output_cycles_.push_back( cycles_ );
+				break;
+			case PRBYTE:
+				for (int shift=4;shift>=0;shift-=4)
+					output_ += "0123456789ABCDEF"[(a_ >> shift) & 0xf];
+				cycles_ += 2*ECHO_CYCLES+30;
+				break;
+			default:
+				std::cerr << "Jump to monitor ROM at " << std::hex << pc_ << std::dec << std::endl;
+				halted_ = true;
+				return;
+		}
+		rts();
+	}
+
+	void nz( uint8_t v )
+	{
+		p_ = (p_ & ~(FN|FZ)) | (v & FN) | (v ? 0 : FZ);
+	}
+
+	void flag( uint8_t f, bool v )
+	{
+		p_ = v ? (p_ | f) : (p_ & ~f);
+	}
+
+	//	Addressing modes
+	uint16_t imm() { return pc_++; }
+	uint16_t zp() { return read( pc_++ ); }
+	uint16_t zpx() { return (read( pc_++ )+x_) & 0xff; }
+	uint16_t zpy() { return (read( pc_++ )+y_) & 0xff; }
+
+	uint16_t abs()
+	{
+		uint16_t adrs = read( pc_ ) | (read( pc_+1 ) << 8);
+		pc_ += 2;
+		return adrs;
+	}
+
+	//	Indexed, with one more cycle if crossing a page (on reads)
+	uint16_t indexed( uint16_t base, uint8_t index, bool penalty )
+	{
+		uint16_t adrs = base+index;
+		if (penalty && (adrs ^ base) & 0xff00)
+			cycles_++;
+		return adrs;
+	}
+
+	uint16_t abx( bool penalty=true ) { return indexed( abs(), x_, penalty ); }
+	uint16_t aby( bool penalty=true ) { return indexed( abs(), y_, penalty ); }
+
+	uint16_t izx()
+	{
+		uint8_t z = read( pc_++ )+x_;
+		return mem_[z] | (mem_[(uint8_t)(z+1)] << 8);
+	}
+
+	uint16_t izy( bool penalty=true )
+	{
+		uint8_t z = read( pc_++ );
+		return indexed( mem_[z] | (mem_[(uint8_t)(z+1)] << 8), y_, penalty );
+	}
+
+	//	Operations
+	void adc( uint8_t m )
+	{
+		int c = p_ & FC;
+		int r = a_ + m + c;
+		if (p_ & FD)
+		{
+			int al = (a_ & 0x0f) + (m & 0x0f) + c;
+			if (al>=0x0a)
+				al = ((al+0x06) & 0x0f) + 0x10;
+			int d = (a_ & 0xf0) + (m & 0xf0) + al;
+			int sd = (int8_t)(a_ & 0xf0) + (int8_t)(m & 0xf0) + al;
+			flag( FZ, !(r & 0xff) );
+			flag( FN, d & 0x80 );
+			flag( FV, sd<-128 || sd>127 );
+			if (d>=0xa0)
+				d += 0x60;
+			flag( FC, d>=0x100 );
+			a_ = d;
+			return;
+		}
+		flag( FV, ~(a_ ^ m) & (a_ ^ r) & 0x80 );
+		flag( FC, r>0xff );
+		a_ = r;
+		nz( a_ );
+	}
+
+	void sbc( uint8_t m )
+	{
+		int c = p_ & FC;
+		int r = a_ - m - (1-c);
+		flag( FV, (a_ ^ m) & (a_ ^ r) & 0x80 );
+		if (p_ & FD)
+		{
+			int al = (a_ & 0x0f) - (m & 0x0f) + c - 1;
+			if (al<0)
+				al = ((al-0x06) & 0x0f) - 0x10;
+			int d = (a_ & 0xf0) - (m & 0xf0) + al;
+			if (d<0)
+				d -= 0x60;
+			nz( r );
+			flag( FC, r>=0 );
+			a_ = d;
+			return;
+		}
+		flag( FC, r>=0 );
+		a_ = r;
+		nz( a_ );
+	}
+
+	void cmp( uint8_t r, uint8_t m )
+	{
+		flag( FC, r>=m );
+		nz( r-m );
+	}
+
+	void bit( uint8_t m )
+	{
+		p_ = (p_ & ~(FN|FV|FZ)) | (m & (FN|FV)) | ((a_ & m) ? 0 : FZ);
+	}
+
+	uint8_t asl( uint8_t v ) { flag( FC, v & 0x80 ); v <<= 1; nz( v ); return v; }
+	uint8_t lsr( uint8_t v ) { flag( FC, v & 0x01 ); v >>= 1; nz( v ); return v; }
+	uint8_t rol( uint8_t v ) { int c = p_ & FC; flag( FC, v & 0x80 ); v = (v << 1) | c; nz( v ); return v; }
+	uint8_t ror( uint8_t v ) { int c = p_ & FC; flag( FC, v & 0x01 ); v = (v >> 1) | (c << 7); nz( v ); return v; }
+	uint8_t inc( uint8_t v ) { nz( ++v ); return v; }
+	uint8_t dec( uint8_t v ) { nz( --v ); return v; }
+
+	//	Read-modify-write on memory
+	template <typename F>
+	void rmw( uint16_t adrs, F op )
+	{
+		write( adrs, (this->*op)( read( adrs ) ) );
+	}
+
+	void branch( bool taken )
+	{
+		int8_t offset = read( pc_++ );
+		cycles_ += 2;
+		if (taken)
+		{
+			uint16_t target = pc_+offset;
+			cycles_ += ((target ^ pc_) & 0xff00) ? 2 : 1;
+			pc_ = target;
+		}
+	}
+
+	void step()
+	{
+		if (pc_cycles_.empty())
+		{
+			execute();
+			return;
+		}
+		uint64_t start = cycles_;
+		op_pc_ = pc_;
+		execute();
+		pc_cycles_[op_pc_] += cycles_-start;
+	}
+
+	void execute()
+	{
+		if (pc_>=0xFF00)
+		{
+			trap();
+			return;
+		}
+
+		uint8_t opcode = read( pc_++ );
+		switch (opcode)
+		{
+			//	Loads and stores
+			case 0xA9: nz( a_ = read( imm() ) ); cycles_ += 2; break;
+			case 0xA5: nz( a_ = read( zp() ) ); cycles_ += 3; break;
+			case 0xB5: nz( a_ = read( zpx() ) ); cycles_ += 4; break;
+			case 0xAD: nz( a_ = read( abs() ) ); cycles_ += 4; break;
+			case 0xBD: nz( a_ = read( abx() ) ); cycles_ += 4; break;
+			case 0xB9: nz( a_ = read( aby() ) ); cycles_ += 4; break;
+			case 0xA1: nz( a_ = read( izx() ) ); cycles_ += 6; break;
+			case 0xB1: nz( a_ = read( izy() ) ); cycles_ += 5; break;
+			case 0xA2: nz( x_ = read( imm() ) ); cycles_ += 2; break;
+			case 0xA6: nz( x_ = read( zp() ) ); cycles_ += 3; break;
+			case 0xB6: nz( x_ = read( zpy() ) ); cycles_ += 4; break;
+			case 0xAE: nz( x_ = read( abs() ) ); cycles_ += 4; break;
+			case 0xBE: nz( x_ = read( aby() ) ); cycles_ += 4; break;
+			case 0xA0: nz( y_ = read( imm() ) ); cycles_ += 2; break;
+			case 0xA4: nz( y_ = read( zp() ) ); cycles_ += 3; break;
+			case 0xB4: nz( y_ = read( zpx() ) ); cycles_ += 4; break;
+			case 0xAC: nz( y_ = read( abs() ) ); cycles_ += 4; break;
+			case 0xBC: nz( y_ = read( abx() ) ); cycles_ += 4; break;
+			case 0x85: write( zp(), a_ ); cycles_ += 3; break;
+			case 0x95: write( zpx(), a_ ); cycles_ += 4; break;
+			case 0x8D: write( abs(), a_ ); cycles_ += 4; break;
+			case 0x9D: write( abx( false ), a_ ); cycles_ += 5; break;
+			case 0x99: write( aby( false ), a_ ); cycles_ += 5; break;
+			case 0x81: write( izx(), a_ ); cycles_ += 6; break;
+			case 0x91: write( izy( false ), a_ ); cycles_ += 6; break;
+			case 0x86: write( zp(), x_ ); cycles_ += 3; break;
+			case 0x96: write( zpy(), x_ ); cycles_ += 4; break;
+			case 0x8E: write( abs(), x_ ); cycles_ += 4; break;
+			case 0x84: write( zp(), y_ ); cycles_ += 3; break;
+			case 0x94: write( zpx(), y_ ); cycles_ += 4; break;
+			case 0x8C: write( abs(), y_ ); cycles_ += 4; break;
+
+			//	Transfers and stack
+			case 0xAA: nz( x_ = a_ ); cycles_ += 2; break;
+			case 0xA8: nz( y_ = a_ ); cycles_ += 2; break;
+			case 0x8A: nz( a_ = x_ ); cycles_ += 2; break;
+			case 0x98: nz( a_ = y_ ); cycles_ += 2; break;
+			case 0xBA: nz( x_ = s_ ); cycles_ += 2; break;
+			case 0x9A: s_ = x_; cycles_ += 2; break;
+			case 0x48: push( a_ ); cycles_ += 3; break;
+			case 0x08: push( p_ | FB | FU ); cycles_ += 3; break;
+			case 0x68: nz( a_ = pull() ); cycles_ += 4; break;
+			case 0x28: p_ = (pull() & ~FB) | FU; cycles_ += 4; break;
+
+			//	Arithmetic and logic
+			case 0x69: adc( read( imm() ) ); cycles_ += 2; break;
+			case 0x65: adc( read( zp() ) ); cycles_ += 3; break;
+			case 0x75: adc( read( zpx() ) ); cycles_ += 4; break;
+			case 0x6D: adc( read( abs() ) ); cycles_ += 4; break;
+			case 0x7D: adc( read( abx() ) ); cycles_ += 4; break;
+			case 0x79: adc( read( aby() ) ); cycles_ += 4; break;
+			case 0x61: adc( read( izx() ) ); cycles_ += 6; break;
+			case 0x71: adc( read( izy() ) ); cycles_ += 5; break;
+			case 0xE9: sbc( read( imm() ) ); cycles_ += 2; break;
+			case 0xE5: sbc( read( zp() ) ); cycles_ += 3; break;
+			case 0xF5: sbc( read( zpx() ) ); cycles_ += 4; break;
+			case 0xED: sbc( read( abs() ) ); cycles_ += 4; break;
+			case 0xFD: sbc( read( abx() ) ); cycles_ += 4; break;
+			case 0xF9: sbc( read( aby() ) ); cycles_ += 4; break;
+			case 0xE1: sbc( read( izx() ) ); cycles_ += 6; break;
+			case 0xF1: sbc( read( izy() ) ); cycles_ += 5; break;
+			case 0x29: nz( a_ &= read( imm() ) ); cycles_ += 2; break;
+			case 0x25: nz( a_ &= read( zp() ) ); cycles_ += 3; break;
+			case 0x35: nz( a_ &= read( zpx() ) ); cycles_ += 4; break;
+			case 0x2D: nz( a_ &= read( abs() ) ); cycles_ += 4; break;
+			case 0x3D: nz( a_ &= read( abx() ) ); cycles_ += 4; break;
+			case 0x39: nz( a_ &= read( aby() ) ); cycles_ += 4; break;
+			case 0x21: nz( a_ &= read( izx() ) ); cycles_ += 6; break;
+			case 0x31: nz( a_ &= read( izy() ) ); cycles_ += 5; break;
+			case 0x09: nz( a_ |= read( imm() ) ); cycles_ += 2; break;
+			case 0x05: nz( a_ |= read( zp() ) ); cycles_ += 3; break;
+			case 0x15: nz( a_ |= read( zpx() ) ); cycles_ += 4; break;
+			case 0x0D: nz( a_ |= read( abs() ) ); cycles_ += 4; break;
+			case 0x1D: nz( a_ |= read( abx() ) ); cycles_ += 4; break;
+			case 0x19: nz( a_ |= read( aby() ) ); cycles_ += 4; break;
+			case 0x01: nz( a_ |= read( izx() ) ); cycles_ += 6; break;
+			case 0x11: nz( a_ |= read( izy() ) ); cycles_ += 5; break;
+			case 0x49: nz( a_ ^= read( imm() ) ); cycles_ += 2; break;
+			case 0x45: nz( a_ ^= read( zp() ) ); cycles_ += 3; break;
+			case 0x55: nz( a_ ^= read( zpx() ) ); cycles_ += 4; break;
+			case 0x4D: nz( a_ ^= read( abs() ) ); cycles_ += 4; break;
+			case 0x5D: nz( a_ ^= read( abx() ) ); cycles_ += 4; break;
+			case 0x59: nz( a_ ^= read( aby() ) ); cycles_ += 4; break;
+			case 0x41: nz( a_ ^= read( izx() ) ); cycles_ += 6; break;
+			case 0x51: nz( a_ ^= read( izy() ) ); cycles_ += 5; break;
+			case 0xC9: cmp( a_, read( imm() ) ); cycles_ += 2; break;
+			case 0xC5: cmp( a_, read( zp() ) ); cycles_ += 3; break;
+			case 0xD5: cmp( a_, read( zpx() ) ); cycles_ += 4; break;
+			case 0xCD: cmp( a_, read( abs() ) ); cycles_ += 4; break;
+			case 0xDD: cmp( a_, read( abx() ) ); cycles_ += 4; break;
+			case 0xD9: cmp( a_, read( aby() ) ); cycles_ += 4; break;
+			case 0xC1: cmp( a_, read( izx() ) ); cycles_ += 6; break;
+			case 0xD1: cmp( a_, read( izy() ) ); cycles_ += 5; break;
+			case 0xE0: cmp( x_, read( imm() ) ); cycles_ += 2; break;
+			case 0xE4: cmp( x_, read( zp() ) ); cycles_ += 3; break;
+			case 0xEC: cmp( x_, read( abs() ) ); cycles_ += 4; break;
+			case 0xC0: cmp( y_, read( imm() ) ); cycles_ += 2; break;
+			case 0xC4: cmp( y_, read( zp() ) ); cycles_ += 3; break;
+			case 0xCC: cmp( y_, read( abs() ) ); cycles_ += 4; break;
+			case 0x24: bit( read( zp() ) ); cycles_ += 3; break;
+			case 0x2C: bit( read( abs() ) ); cycles_ += 4; break;
+
+			//	Increments, decrements and shifts
+			case 0xE8: nz( ++x_ ); cycles_ += 2; break;
+			case 0xC8: nz( ++y_ ); cycles_ += 2; break;
+			case 0xCA: nz( --x_ ); cycles_ += 2; break;
+			case 0x88: nz( --y_ ); cycles_ += 2; break;
+			case 0xE6: rmw( zp(), &cpu6502_t::inc ); cycles_ += 5; break;
+			case 0xF6: rmw( zpx(), &cpu6502_t::inc ); cycles_ += 6; break;
+			case 0xEE: rmw( abs(), &cpu6502_t::inc ); cycles_ += 6; break;
+			case 0xFE: rmw( abx( false ), &cpu6502_t::inc ); cycles_ += 7; break;
+			case 0xC6: rmw( zp(), &cpu6502_t::dec ); cycles_ += 5; break;
+			case 0xD6: rmw( zpx(), &cpu6502_t::dec ); cycles_ += 6; break;
+			case 0xCE: rmw( abs(), &cpu6502_t::dec ); cycles_ += 6; break;
+			case 0xDE: rmw( abx( false ), &cpu6502_t::dec ); cycles_ += 7; break;
+			case 0x0A: a_ = asl( a_ ); cycles_ += 2; break;
+			case 0x06: rmw( zp(), &cpu6502_t::asl ); cycles_ += 5; break;
+			case 0x16: rmw( zpx(), &cpu6502_t::asl ); cycles_ += 6; break;
+			case 0x0E: rmw( abs(), &cpu6502_t::asl ); cycles_ += 6; break;
+			case 0x1E: rmw( abx( false ), &cpu6502_t::asl ); cycles_ += 7; break;
+			case 0x4A: a_ = lsr( a_ ); cycles_ += 2; break;
+			case 0x46: rmw( zp(), &cpu6502_t::lsr ); cycles_ += 5; break;
+			case 0x56: rmw( zpx(), &cpu6502_t::lsr ); cycles_ += 6; break;
+			case 0x4E: rmw( abs(), &cpu6502_t::lsr ); cycles_ += 6; break;
+			case 0x5E: rmw( abx( false ), &cpu6502_t::lsr ); cycles_ += 7; break;
+			case 0x2A: a_ = rol( a_ ); cycles_ += 2; break;
+			case 0x26: rmw( zp(), &cpu6502_t::rol ); cycles_ += 5; break;
+			case 0x36: rmw( zpx(), &cpu6502_t::rol ); cycles_ += 6; break;
+			case 0x2E: rmw( abs(), &cpu6502_t::rol ); cycles_ += 6; break;
+			case 0x3E: rmw( abx( false ), &cpu6502_t::rol ); cycles_ += 7; break;
+			case 0x6A: a_ = ror( a_ ); cycles_ += 2; break;
+			case 0x66: rmw( zp(), &cpu6502_t::ror ); cycles_ += 5; break;
+			case 0x76: rmw( zpx(), &cpu6502_t::ror ); cycles_ += 6; break;
+			case 0x6E: rmw( abs(), &cpu6502_t::ror ); cycles_ += 6; break;
+			case 0x7E: rmw( abx( false ), &cpu6502_t::ror ); cycles_ += 7; break;
+
+			//	Branches
+			case 0x10: branch( !(p_ & FN) ); break;
+			case 0x30: branch( p_ & FN ); break;
+			case 0x50: branch( !(p_ & FV) ); break;
+			case 0x70: branch( p_ & FV ); break;
+			case 0x90: branch( !(p_ & FC) ); break;
+			case 0xB0: branch( p_ & FC ); break;
+			case 0xD0: branch( !(p_ & FZ) ); break;
+			case 0xF0: branch( p_ & FZ ); break;
+
+			//	Jumps and subroutines
+			case 0x4C: pc_ = abs(); cycles_ += 3; break;
+			case 0x6C:
+			{
+				//	NMOS bug: the high byte is read from the same page
+				uint16_t ptr = abs();
+				pc_ = read( ptr ) | (read( (ptr & 0xff00) | ((ptr+1) & 0xff) ) << 8);
+				cycles_ += 5;
+				break;
+			}
+			case 0x20:
+			{
+				uint16_t target = abs();
+				push16( pc_-1 );
+				cycles_ += 6;
+				enter( target );
+				pc_ = target;
+				break;
+			}
+			case 0x60: rts(); break;
+			case 0x40: p_ = (pull() & ~FB) | FU; pc_ = pull16(); cycles_ += 6; break;
+
+			//	Flags
+			case 0x18: p_ &= ~FC; cycles_ += 2; break;
+			case 0x38: p_ |= FC; cycles_ += 2; break;
+			case 0x58: p_ &= ~FI; cycles_ += 2; break;
+			case 0x78: p_ |= FI; cycles_ += 2; break;
+			case 0xB8: p_ &= ~FV; cycles_ += 2; break;
+			case 0xD8: p_ &= ~FD; cycles_ += 2; break;
+			case 0xF8: p_ |= FD; cycles_ += 2; break;
+			case 0xEA: cycles_ += 2; break;
+
+			default:
+				std::cerr << "Illegal opcode " << std::hex << (int)opcode << " at " << pc_-1 << std::dec << std::endl;
+				pc_--;
+				halted_ = true;
+		}
+	}
+};
+
+const char *SAMPLE_LISTING_NAME = "sample.lst";
+
+//	Parses a checked-in excerpt of the xa listing
+void test_load_lst()
+{
+	symbols_t sym;
+	assert( sym.load_lst( SAMPLE_LISTING_NAME ) );
+
+	//	Equates, in hex, decimal and *
+	assert( sym["ECHO"]==0xFFEF );
+	assert( sym["SEED"]==0x0D );
+	assert( sym["SQUARETABLE"]==0x1000 );
+	assert( sym["SCREENWIDTH"]==40 );
+	assert( sym["START"]==0x0280 );
+	assert( sym["END"]==0x08A6 );
+
+	//	Labels, and local labels inside .( .)
+	assert( sym["RANDOM"]==0x070E );
+	assert( sym["RANDOM.SKIP"]==0x0715 );
+	assert( sym["INCPTR"]==0x0718 );
+	assert( sym["INCPTR.DONE"]==0x071F );
+	assert( sym.name( 0x0715 )=="RANDOM.SKIP" );
+
+	//	Mnemonics are not labels, and the listing replaces the default symbols
+	assert( sym.labels( 0x0280, 0x1000 ).size()==6 );
+	assert( sym.name( 0x0720 )=="$0720" );
+}
+
+//	Checks a few 6502 instructions, including cycle counts and decimal mode
+void test_cpu6502()
+{
+	cpu6502_t cpu;
+	auto run = [&]( std::vector<uint8_t> code )
+	{
+		code.push_back( 0x60 );	//	RTS
+		std::copy( code.begin(), code.end(), cpu.mem_.begin()+0x300 );
+		return cpu.call( 0x300 )-12;	//	JSR + RTS
+	};
+
+	//	SED CLC LDA #$19 ADC #$28 CLD
+	assert( run( { 0xF8, 0x18, 0xA9, 0x19, 0x69, 0x28, 0xD8 } )==10 );
+	assert( cpu.a_==0x47 && !(cpu.p_ & cpu6502_t::FC) );
+
+	//	SED SEC LDA #$10 SBC #$01 CLD
+	assert( run( { 0xF8, 0x38, 0xA9, 0x10, 0xE9, 0x01, 0xD8 } )==10 );
+	assert( cpu.a_==0x09 && (cpu.p_ & cpu6502_t::FC) );
+
+	//	LDX #$FF LDA $02F1,X (page crossing)
+	cpu.mem_[0x03F0] = 0x42;
+	assert( run( { 0xA2, 0xFF, 0xBD, 0xF1, 0x02 } )==7 );
+	assert( cpu.a_==0x42 );
+
+	//	CLC LDA #$7F ADC #$01 BVS +0 (taken)
+	assert( run( { 0x18, 0xA9, 0x7F, 0x69, 0x01, 0x70, 0x00 } )==9 );
+	assert( cpu.a_==0x80 && (cpu.p_ & cpu6502_t::FV) && (cpu.p_ & cpu6502_t::FN) );
+
+	//	ECHO
+	cpu.output_.clear();
+	run( { 0xA9, 0xC1, 0x20, 0xEF, 0xFF } );
+	assert( cpu.output_=="A" );
+}
+
+const char *BINARY_NAME = "../mandelbrot65.o65";
+const char *LISTING_NAME = "../mandelbrot65.lst";
+const uint16_t BINARY_ADRS = 0x0280;
+
+//	Reads the symbols from the listing of the binary (the V1.1 addresses if it cannot be read),
+//	then sets up a cpu with the binary loaded and the square table filled
+void emu_setup( cpu6502_t &cpu, symbols_t &sym, const char *listing=LISTING_NAME, const char *binary=BINARY_NAME )
+{
+	sym.load_lst( listing );
+	cpu.load( binary, BINARY_ADRS );
+	cpu.call( sym["FILLSQUARES"] );
+}
+
+//	Draws a place with DRAWSET, returns the characters displayed
+std::string emu_drawset( cpu6502_t &cpu, const symbols_t &sym, const asm_place_t &place )
+{
+	cpu.set16( sym["X0"], place.x_ );
+	cpu.set16( sym["Y0"], place.y_ );
+	cpu.set16( sym["DX"], place.dx_ );
+	cpu.set16( sym["DY"], place.dy_ );
+	cpu.mem_[sym["ZOOMLEVEL"]] = place.zoom_;
+	cpu.mem_[sym["ABORT"]] = 0;
+	cpu.output_.clear();
+	cpu.output_cycles_.clear();
+	cpu.call( sym["DRAWSET"] );
+	return cpu.output_;
+}
+
+//	Runs a MANDELAUTO loop step in the emulator (INITIALPLACE then DRAWSET) and
+//	compares it with the model
+bool check_demo_screen( cpu6502_t &cpu, const symbols_t &sym, const demo_screen_t &screen, uint8_t seed )
+{
+	cpu.mem_[sym["SEED"]] = seed;
+	cpu.call( sym["INITIALPLACE"] );
+	auto s = emu_drawset( cpu, sym, screen.place_ );
+	return s==screen.chars_ && cpu.mem_[sym["SEED"]]==screen.seed_ &&
+		cpu.get16( sym["NEXTX"] )==screen.next_.x_ && cpu.get16( sym["NEXTY"] )==screen.next_.y_ &&
+		cpu.get16( sym["NEXTDX"] )==screen.next_.dx_ && cpu.get16( sym["NEXTDY"] )==screen.next_.dy_ &&
+		cpu.mem_[sym["NEXTZOOMLEVEL"]]==screen.next_.zoom_;
+}
+
+//	Prints the inclusive cycles and call count of each subroutine
+void print_routines( const cpu6502_t &cpu, const symbols_t &sym )
+{
+	std::cout << std::endl << "Routine          calls        cycles   cycles/call" << std::endl;
+	for (int adrs=0;adrs!=0x10000;adrs++)
+	{
+		auto &r = cpu.routines_[adrs];
+		if (r.calls_)
+			printf( "%-12s %9llu %13llu %13.1f\n", sym.name( adrs ).c_str(),
+				(unsigned long long)r.calls_, (unsigned long long)r.cycles_, (double)r.cycles_/r.calls_ );
+	}
+}
+
+//	Prints the exclusive cycles of each label, with the part spent in zero page loads
+//	and stores (MLOADAX/MSTOREAX) and in instructions reading the square table
+void print_profile( const cpu6502_t &cpu, const symbols_t &sym )
+{
+	auto labels = sym.labels( BINARY_ADRS, 0x1000 );
+	auto rom = sym.labels( 0xFF00, 0xFFFF );
+	labels.insert( labels.end(), rom.begin(), rom.end() );
+
+	struct region_t
+	{
+		uint64_t cycles_ = 0;
+		uint64_t zp_ = 0;
+		uint64_t table_ = 0;
+	};
+	std::vector<region_t> regions( labels.size() );
+	region_t total;
+
+	for (int pc=0;pc!=0x10000;pc++)
+	{
+		uint64_t c = cpu.pc_cycles_[pc];
+		if (!c)
+			continue;
+		auto it = std::upper_bound( labels.begin(), labels.end(), pc, []( int pc, auto &l ){ return pc<l.adrs_; } );
+		if (it==labels.begin())
+			continue;
+		auto &r = regions[it-labels.begin()-1];
+		uint8_t op = cpu.mem_[pc];
+		bool zp = op==0xA5 || op==0xA6 || op==0xA4 || op==0x85 || op==0x86 || op==0x84;
+		for (auto p:{ &r, &total })
+		{
+			p->cycles_ += c;
+			p->zp_ += zp ? c : 0;
+			p->table_ += cpu.pc_table_[pc] ? c : 0;
+		}
+	}
+
+	std::vector<int> order;
+	for (int i=0;i!=regions.size();i++)
+		if (regions[i].cycles_)
+			order.push_back( i );
+	std::sort( order.begin(), order.end(), [&]( int a, int b ){ return regions[a].cycles_>regions[b].cycles_; } );
+
+	std::cout << std::endl << "Label                        cycles      %     zp ld/st    sqr table" << std::endl;
+	for (auto i:order)
+	{
+		auto &r = regions[i];
+		printf( "%-22s %13llu %6.2f %12llu %12llu\n", labels[i].name_.c_str(), (unsigned long long)r.cycles_,
+			100.0*r.cycles_/total.cycles_, (unsigned long long)r.zp_, (unsigned long long)r.table_ );
+	}
+	printf( "%-22s %13llu %6.2f %12llu %12llu\n", "TOTAL", (unsigned long long)total.cycles_, 100.0,
+		(unsigned long long)total.zp_, (unsigned long long)total.table_ );
+	printf( "\nZero page loads/stores: %.2f%%, square table reads: %.2f%%\n",
+		100.0*total.zp_/total.cycles_, 100.0*total.table_/total.cycles_ );
+}
+
+const int PROFILE_SCREENS = 8;
+
+//	Profiles the ASM drawing a zoom sequence, as MANDELAUTO does (without the waits)
+//	Each screen is written by img_output as /tmp/mandelN.pbm, with its cycles per character
+//	as a /tmp/mandelN.pgm heatmap
+int profile_main( const char *listing, const char *binary )
+{
+	symbols_t sym;
+	cpu6502_t cpu;
+	emu_setup( cpu, sym, listing, binary );
+	cpu.track_routines( true );
+	cpu.profile( true );
+	cpu.mem_[sym["SEED"]] = 1;
+
+	font_t font("s2513.d2");
+	img_output out( font );
+
+	cpu.call( sym["INITIALPLACE"] );
+	for (int n=0;n!=PROFILE_SCREENS;n++)
+	{
+		cpu.call( sym["GOTOPLACE"] );
+		asm_place_t place = { cpu.get16( sym["X0"] ), cpu.get16( sym["Y0"] ),
+			cpu.get16( sym["DX"] ), cpu.get16( sym["DY"] ), cpu.mem_[sym["ZOOMLEVEL"]] };
+		cpu.call( sym["INITIALPLACE"] );
+
+		uint64_t start = cpu.cycles_;
+		auto s = emu_drawset( cpu, sym, place );
+		std::cout << "Screen " << n << " ZOOMLEVEL " << place.zoom_ << ": " << cpu.cycles_-start << " cycles" << std::endl;
+
+		std::vector<uint64_t> heat( SCREENWIDTH*SCREENHEIGHT, 0 );
+		for (int i=0;i!=cpu.output_cycles_.size() && i!=heat.size();i++)
+			heat[i] = cpu.output_cycles_[i]-(i ? cpu.output_cycles_[i-1] : start);
+		out.set_heatmap( heat );
+
+		out.output_start( "profile", SCREENWIDTH, SCREENHEIGHT );
+		for (int i=0;i!=SCREENHEIGHT;i++)
+			for (int j=0;j!=SCREENWIDTH;j++)
+			{
+				int k = i*SCREENWIDTH+j;
+				auto fx = packed_t::raw( place.x_+j*place.dx_ );
+				auto fy = packed_t::raw( place.y_+i*place.dy_ );
+				out.output( k<s.size() ? s[k] : ' ', fx, fy );
+			}
+		out.output_end();
+	}
+
+	print_routines( cpu, sym );
+	print_profile( cpu, sym );
+
+	return 0;
+}
+
+//	Runs the ASM DRAWSET on the emulator, prints the screen and the cycles of each routine
+//	and checks the result against the C++ model
+int emu_main( const char *binary, const char *listing )
+{
+	symbols_t sym;
+	cpu6502_t cpu;
+	cpu.track_routines( true );
+
+	auto start = std::chrono::steady_clock::now();
+
+	emu_setup( cpu, sym, listing, binary );
+
+	//	Square table must be the C++ one
+	bool table_ok = true;
+	for (int n=0;n!=SQUARETABLE_SIZE;n++)
+		table_ok &= cpu.get16( 0x1000+2*n )==squaretable[n];
+	std::cout << "FILLSQUARES: " << (table_ok ? "same" : "DIFFERENT") << " square table" << std::endl;
+
+	//	Zoom level tables must be zoomlevels, the palettes read through PALETTEDELTA
+	for (int zoom=0;zoom!=ZOOMLEVELS;zoom++)
+	{
+		auto &level = zoomlevels[zoom];
+		table_ok &= cpu.mem_[sym["MAXITER"]+zoom]==level.maxiter_ &&
+			cpu.mem_[sym["ZOOMTRIGGERMIN"]+zoom]==level.triggermin_ &&
+			cpu.mem_[sym["ZOOMTRIGGERMAX"]+zoom]==level.triggermax_;
+		int delta = cpu.mem_[sym["PALETTEDELTA"]+zoom];
+		for (int it=0;it<=level.maxiter_;it++)
+			table_ok &= cpu.mem_[sym["PALETTE"]+delta+it]==zoom_palettes[zoom][it];
+	}
+	std::cout << "Zoom levels: " << (table_ok ? "same" : "DIFFERENT") << " tables" << std::endl;
+
+	bool screens_ok = true;
+	for (int zoom=0;zoom!=ZOOMLEVELS;zoom++)
+	{
+		auto place = asm_place_t::initial();
+		place.zoom_ = zoom;
+		auto s = emu_drawset( cpu, sym, place );
+		bool ok = s==drawset_model( place );
+		screens_ok &= ok;
+		std::cout << "ZOOMLEVEL " << zoom << ": " << (ok ? "same" : "DIFFERENT") << " screen" << std::endl;
+		for (auto &line:cpu.screen())
+			std::cout << "  |" << line << std::endl;
+	}
+
+	//	A MANDELAUTO run, through the zoom levels and back (SEED 0 included: RANDOM stays 0)
+	bool demo_ok = true;
+	for (int seed:{ 0, 1, 0x5A })
+	{
+		auto screen = demo_screen_model( asm_place_t::initial(), seed );
+		for (int k=0;k!=ZOOMLEVELS+1;k++)
+		{
+			demo_ok &= check_demo_screen( cpu, sym, screen, seed );
+			seed = screen.seed_;
+			screen = demo_screen_model( screen.next_, seed );
+		}
+	}
+	std::cout << "MANDELAUTO: " << (demo_ok ? "same" : "DIFFERENT") << " screens and next places" << std::endl;
+
+	double seconds = std::chrono::duration<double>( std::chrono::steady_clock::now()-start ).count();
+
+	print_routines( cpu, sym );
+	printf( "\n%llu cycles in %.3f seconds (%.1f MHz)\n", (unsigned long long)cpu.cycles_, seconds, cpu.cycles_/seconds/1e6 );
+
+	return table_ok && screens_ok && demo_ok ? 0 : 1;
+}
+
+//	-----------------------------------------------------------------------------
+//	Differential test of the emulated ITER against the C++ model
+//	-----------------------------------------------------------------------------
+
+//	A point where the emulated ASM and a C++ model disagree, as stored in the logs
+#pragma pack(push,1)
+struct divergence_t
+{
+	int16_t x_;
+	int16_t y_;
+	uint8_t asm_;
+	uint8_t model_;
+};
+#pragma pack(pop)
+
+const char *DIVERGENCE_NAME = "/tmp/divergences.bin";
+const char *ITER_DIVERGENCE_NAME = "/tmp/divergences_iter.bin";
+
+//	Past this raw value the first SQUARE of ITER overflows, so ITER returns 0
+//	without iterating: only [-DIFF_LIMIT,DIFF_LIMIT] needs to be emulated
+//	(the bounds are included to check that claim)
+const int DIFF_LIMIT = 0x1000;
+
+//	Writes a divergence log: "MDIV", zoom level, count (32 bits) then count divergence_t
+void write_divergences( const char *filename, int zoom, std::vector<divergence_t> &divergences )
+{
+	std::sort( divergences.begin(), divergences.end(), []( auto &a, auto &b ){ return a.y_!=b.y_ ? a.y_<b.y_ : a.x_<b.x_; } );
+
+	std::ofstream ofs(filename, std::ios::binary);
+	if (!ofs) {
+		std::cerr << "Cannot open file " << filename << std::endl;
+		exit(1);
+	}
+	uint32_t header[2] = { (uint32_t)zoom, (uint32_t)divergences.size() };
+	ofs.write( "MDIV", 4 );
+	ofs.write( (const char *)header, sizeof(header) );
+	ofs.write( (const char *)divergences.data(), divergences.size()*sizeof(divergence_t) );
+}
+
+//	Prints the count and the first divergences of a log
+void print_divergences( const char *model, const char *filename, const std::vector<divergence_t> &divergences )
+{
+	printf( "ASM vs %s: %zu divergences (written to %s)\n", model, divergences.size(), filename );
+	for (int i=0;i!=std::min<int>( 10, divergences.size() );i++)
+	{
+		auto &d = divergences[i];
+		printf( "  x=%s y=%s asm=%d %s=%d\n", packed_t::raw( d.x_ ).to_string().c_str(),
+			packed_t::raw( d.y_ ).to_string().c_str(), d.asm_, model, d.model_ );
+	}
+}
+
+//	Compares the emulated ITER with iter_asm, and with the iter of the reference
+//	images (capped at the MAXITER of the zoom level), on every step-th coordinate pair
+//	iter_asm must match exactly. iter is expected to differ: the ASM gets 2*zx*zy
+//	from the square of zx-zy, and stops when that square overflows, so it escapes
+//	earlier on some points. Those divergences are only logged
+//	The logs are DIVERGENCE_NAME (iter_asm) and ITER_DIVERGENCE_NAME (iter)
+int diff_main( int step, int zoom, const char *listing )
+{
+	if (step<1 || zoom<0 || zoom>=ZOOMLEVELS)
+	{
+		std::cerr << "Usage: validate diff [step] [zoomlevel] [listing]" << std::endl;
+		exit(1);
+	}
+
+	symbols_t sym;
+	cpu6502_t base;
+	emu_setup( base, sym, listing );
+	base.mem_[sym["ZOOMLEVEL"]] = zoom;
+	const uint16_t adrs_x = sym["X"], adrs_y = sym["Y"], adrs_it = sym["IT"], adrs_iter = sym["ITER"];
+	const int maxiter = zoomlevels[zoom].maxiter_;
+
+	std::vector<int> coords;
+	for (int v=-DIFF_LIMIT;v<=DIFF_LIMIT;v+=2*step)
+		coords.push_back( v );
+
+	std::mutex mutex;
+	std::vector<divergence_t> divergences, iter_divergences;
+	uint64_t cycles = 0;
+	bool halted = false;
+
+	auto start = std::chrono::steady_clock::now();
+
+	//	One job per row, each with its own cpu
+	tile_pool.run( coords.size(), [&]( int j )
+	{
+		cpu6502_t cpu = base;
+		std::vector<divergence_t> found, iter_found;
+		uint16_t y = coords[j];
+		packed_t py = packed_t::raw( coords[j] );
+		for (auto xv:coords)
+		{
+			uint16_t x = xv;
+			cpu.set16( adrs_x, x );
+			cpu.set16( adrs_y, y );
+			cpu.call( adrs_iter );
+			int it = cpu.mem_[adrs_it];
+			int model = iter_asm( x, y, maxiter );
+			if (it!=model)
+				found.push_back( { (int16_t)x, (int16_t)y, (uint8_t)it, (uint8_t)model } );
+			packed_t px = packed_t::raw( xv );
+			int reference = std::min( iter( px, py, px, py ), maxiter );
+			if (it!=reference)
+				iter_found.push_back( { (int16_t)x, (int16_t)y, (uint8_t)it, (uint8_t)reference } );
+		}
+		std::lock_guard<std::mutex> lock(mutex);
+		divergences.insert( divergences.end(), found.begin(), found.end() );
+		iter_divergences.insert( iter_divergences.end(), iter_found.begin(), iter_found.end() );
+		cycles += cpu.cycles_-base.cycles_;
+		halted |= cpu.halted_;
+	} );
+
+	double seconds = std::chrono::duration<double>( std::chrono::steady_clock::now()-start ).count();
+
+	write_divergences( DIVERGENCE_NAME, zoom, divergences );
+	write_divergences( ITER_DIVERGENCE_NAME, zoom, iter_divergences );
+
+	uint64_t points = (uint64_t)coords.size()*coords.size();
+	printf( "ZOOMLEVEL %d, step %d: %llu points\n", zoom, step, (unsigned long long)points );
+	printf( "%llu cycles in %.3f seconds (%.1f MHz, %d threads)\n", (unsigned long long)cycles, seconds,
+		cycles/seconds/1e6, tile_pool.threads() );
+	print_divergences( "iter_asm", DIVERGENCE_NAME, divergences );
+	print_divergences( "iter", ITER_DIVERGENCE_NAME, iter_divergences );
+	if (halted)
+		std::cerr << "The emulated cpu halted" << std::endl;
+
+	return divergences.empty() && !halted ? 0 : 1;
+}
+
+//	-----------------------------------------------------------------------------
+//	Benchmarks
+//	-----------------------------------------------------------------------------
+
+//	Discards everything
+class null_output : public ioutput
+{
+public:
+	virtual void do_output( char c, fixed_t fx, fixed_t fy ) {}
+};
+
+const int BENCH_WARMUP=2;
+const int BENCH_MIN_SAMPLES=5;
+const int BENCH_MAX_SAMPLES=31;
+const double BENCH_BUDGET=1.0;	//	Seconds of samples per benchmark, past the minimum
+
+struct bench_result_t
+{
+	std::string name_;
+	double ops_;			//	Operations per run
+	std::vector<double> seconds_;	//	Sorted run times
+
+	double percentile( double p ) const
+	{
+		return seconds_[std::min<size_t>( seconds_.size()-1, p*seconds_.size() )];
+	}
+};
+
+//	Runs fn (which does ops operations) after a warmup, until the budget is spent
+//	The renders print progress on std::cout: it is muted while running
+template <typename F>
+bench_result_t bench( const std::string &name, double ops, F fn )
+{
+	auto buf = std::cout.rdbuf( nullptr );
+	bench_result_t r = { name, ops, {} };
+	for (int i=0;i!=BENCH_WARMUP;i++)
+		fn();
+	double total = 0;
+	while (r.seconds_.size()<BENCH_MIN_SAMPLES || (total<BENCH_BUDGET && r.seconds_.size()<BENCH_MAX_SAMPLES))
+	{
+		auto start = std::chrono::steady_clock::now();
+		fn();
+		double s = std::chrono::duration<double>( std::chrono::steady_clock::now()-start ).count();
+		r.seconds_.push_back( s );
+		total += s;
+	}
+	std::cout.rdbuf( buf );
+	std::cout.clear();
+	std::sort( r.seconds_.begin(), r.seconds_.end() );
+	return r;
+}
+
+//	Keeps the benchmarked results alive
+volatile int bench_sink;
+
+//	The cpus the process may run on
+std::vector<int> bench_cpus()
+{
+	std::vector<int> cpus;
+#ifdef __linux__
+	cpu_set_t set;
+	if (sched_getaffinity( 0, sizeof(set), &set )==0)
+		for (int cpu=0;cpu!=CPU_SETSIZE;cpu++)
+			if (CPU_ISSET( cpu, &set ))
+				cpus.push_back( cpu );
+#endif
+	return cpus;
+}
+
+//	Benchmarks the number formats, iter and the renders of the places of main
+//	Prints the results as JSON
+//	To avoid migrations during measures, the serial benchmarks run pinned on the
+//	first cpu, and the multithreaded ones on a pool with one thread pinned per cpu
+int bench_main()
+{
+	auto cpus = bench_cpus();
+	bool pinned = !cpus.empty() && pin_thread( cpus[0] );
+	tile_pool_t pool = pinned ? tile_pool_t( cpus ) : tile_pool_t();
+	font_t font("s2513.d2");
+	null_output out;
+	std::vector<bench_result_t> results;
+
+	//	Number formats, on every positive and negative value
+	const int N = 2*PACKED_MAX/2+1;
+	std::vector<fixed_t> fs;
+	std::vector<packed_t> ps;
+	for (int v=-PACKED_MAX;v<=PACKED_MAX;v+=2)
+	{
+		ps.push_back( packed_t::raw( v ) );
+		fs.push_back( ps.back() );
+	}
+	auto numbers = [&]( const char *name, auto &vs, auto op )
+	{
+		results.push_back( bench( name, N, [&]()
+		{
+			int sink = 0;
+			for (int k=0;k!=N;k++)
+				sink += op( vs[k], vs[N-1-k] ).is_nan();
+			bench_sink = sink;
+		} ) );
+	};
+	numbers( "fixed_t.add", fs, []( fixed_t a, fixed_t b ) { return a+b; } );
+	numbers( "fixed_t.squared", fs, []( fixed_t a, fixed_t b ) { return a.squared(); } );
+	numbers( "fixed_t.mul2", fs, []( fixed_t a, fixed_t b ) { return a.mul2(b); } );
+	numbers( "packed_t.add", ps, []( packed_t a, packed_t b ) { return a+b; } );
+	numbers( "packed_t.squared", ps, []( packed_t a, packed_t b ) { return a.squared(); } );
+	numbers( "packed_t.mul2", ps, []( packed_t a, packed_t b ) { return a.mul2(b); } );
+
+	//	iter, per iteration: points of the set (without periodicity check, so all
+	//	ITER_MAX iterations are done) and escaping points of the p1 screen
+	std::vector<packed_t> inset, escaping;
+	for (int y=-256;y<=256;y+=16)
+		for (int x=-1024;x<=256;x+=16)
+		{
+			auto px = packed_t::epsilon( x ), py = packed_t::epsilon( y );
+			int it = iter( px, py, px, py );
+			if (it==ITER_MAX)
+				inset.push_back( px ), inset.push_back( py );
+			else if (it>2)
+				escaping.push_back( px ), escaping.push_back( py );
+		}
+	auto iterations = [&]( const char *name, auto &points, auto t, bool periodicity )
+	{
+		typedef decltype(t) T;
+		double ops = 0;
+		for (size_t k=0;k<points.size();k+=2)
+			ops += iter<T>( points[k], points[k+1], points[k], points[k+1], periodicity );
+		results.push_back( bench( name, ops, [&]()
+		{
+			int sink = 0;
+			for (size_t k=0;k<points.size();k+=2)
+			{
+				T x = points[k], y = points[k+1];
+				sink += iter<T>( x, y, x, y, periodicity );
+			}
+			bench_sink = sink;
+		} ) );
+	};
+	iterations( "iter<fixed_t>.inset", inset, fixed_t(), false );
+	iterations( "iter<fixed_t>.escaping", escaping, fixed_t(), false );
+	iterations( "iter<packed_t>.inset", inset, packed_t(), false );
+	iterations( "iter<packed_t>.inset.periodicity", inset, packed_t(), true );
+	iterations( "iter<packed_t>.escaping", escaping, packed_t(), false );
+
+	//	Renders, per point
+	struct preset_t
+	{
+		const char *name_;
+		place_t place_;
+	};
+	preset_t mandels[] =
+	{
+		{ "p1", place_t(-0.61,0,19,24) },
+		{ "p2", place_t(-1.04,-0.33,1,1) },
+		{ "p3", place_t(-1.38,0.123,1,1) },
+		{ "p4", place_t(-1.47,0,1,1) },
+		{ "p5", place_t(-0.62,-0.45,1,1) },
+		{ "p0", place_t(-0.61,0,1,1,576,512) },
+	};
+	preset_t julias[] =
+	{
+		{ "j0", place_t(0,0,25,40) },
+		{ "j1", place_t(0.8,0,12,20) },
+	};
+	for (auto &p:mandels)
+	{
+		double points = p.place_.w_*p.place_.h_;
+		std::string name = p.name_;
+		results.push_back( bench( "mandel."+name, points, [&]() { mandel( p.place_, out ); } ) );
+		results.push_back( bench( "mandel_mt<packed_t>."+name, points, [&]() { mandel_mt<packed_t>( p.place_, out, pool ); } ) );
+		results.push_back( bench( "mandelhr."+name, points, [&]() { mandelhr( p.place_, out, font ); } ) );
+		results.push_back( bench( "mandelhr_mt<packed_t>."+name, points, [&]() { mandelhr_mt<packed_t>( p.place_, out, font, pool ); } ) );
+		results.push_back( bench( "mandelhr_adaptive<packed_t>."+name, points, [&]() { mandelhr_adaptive<packed_t>( p.place_, out, font, false, pool ); } ) );
+	}
+	for (auto &p:julias)
+	{
+		double points = p.place_.w_*p.place_.h_;
+		std::string name = p.name_;
+		results.push_back( bench( "julia."+name, points, [&]() { julia( p.place_, -0.8, 0.156, out ); } ) );
+		results.push_back( bench( "julia_mt<packed_t>."+name, points, [&]() { julia_mt<packed_t>( p.place_, -0.8, 0.156, out, pool ); } ) );
+	}
+
+	//	Deep zoom, per iteration, with the scalar and the SIMD perturbation
+	dd_t deep_x, deep_y;
+	dd_t::parse( DEEP_X, deep_x );
+	dd_t::parse( DEEP_Y, deep_y );
+	deep_place_t deep( deep_x, deep_y, 1e-12, 1e-12, 160, 96 );
+	deep_stats_t deep_stats;
+	deep_render( deep, DEEP_MAXITER, deep_stats, pool );
+	results.push_back( bench( "deep_render.scalar", deep_stats.iterations_, [&]() { deep_stats_t s; deep_render( deep, DEEP_MAXITER, s, pool, deep_row_scalar ); } ) );
+	results.push_back( bench( "deep_render", deep_stats.iterations_, [&]() { deep_stats_t s; deep_render( deep, DEEP_MAXITER, s, pool ); } ) );
+
+	printf( "{\n  \"pinned\": %s,\n  \"threads\": %d,\n  \"benchmarks\": [\n", pinned ? "true" : "false", pool.threads() );
+	for (size_t i=0;i!=results.size();i++)
+	{
+		auto &r = results[i];
+		printf( "    { \"name\": \"%s\", \"ops\": %.0f, \"samples\": %zu, \"min_s\": %.9f, \"p10_s\": %.9f, \"median_s\": %.9f, \"p90_s\": %.9f, \"median_ns_per_op\": %.3f }%s\n",
+			r.name_.c_str(), r.ops_, r.seconds_.size(), r.seconds_.front(), r.percentile( 0.1 ), r.percentile( 0.5 ),
+			r.percentile( 0.9 ), r.percentile( 0.5 )*1e9/r.ops_, i+1==results.size() ? "" : "," );
+	}
+	printf( "  ]\n}\n" );
+
+	return 0;
+}
+
+//	-----------------------------------------------------------------------------
+//	Offline zoom path planner
+//	-----------------------------------------------------------------------------
+
+//	SELECTNEXT picks the next place at random among the pixels of the screen with
+//	ZOOMTRIGGERMIN <= it < ZOOMTRIGGERMAX, and many picks end on dull screens
+//	The planner does a beam search on the same candidates, scores each screen by
+//	the diversity of its characters, and prints the best paths as .byte data
+
+const int PLAN_PATHS=16;
+const int PLAN_BEAM=64;
+
+//	Gini-Simpson diversity of the characters of a screen: the probability that two
+//	characters taken at random differ (0 for a uniform screen)
+//	(used instead of the Shannon entropy, which would need libm)
+double screen_diversity( const std::string &s )
+{
+	int counts[256] = {};
+	for (unsigned char c:s)
+		counts[c]++;
+	double same = 0;
+	for (int n:counts)
+		same += (double)n*n;
+	return 1-same/((double)s.size()*s.size());
+}
+
+//	The places SELECTNEXT can choose while DRAWSET displays a place
+std::vector<asm_place_t> zoom_candidates( const asm_place_t &place )
+{
+	return with_zoomlevel( place.zoom_, [&]( auto zoom )
+	{
+		constexpr zoomlevel_t level = zoomlevels[zoom];
+		std::vector<asm_place_t> candidates;
+		uint16_t y = place.y_;
+		for (int i=0;i!=SCREENHEIGHT;i++)
+		{
+			uint16_t x = place.x_;
+			for (int j=0;j!=SCREENWIDTH;j++)
+			{
+				//	The last character is not displayed
+				if (i==SCREENHEIGHT-1 && j==SCREENWIDTH-1)
+					break;
+				int it = iter_asm<level.maxiter_>( x, y );
+				asm_place_t next;
+				if (it>=level.triggermin_ && it<level.triggermax_ && select_next_model( place, x, y, next ))
+					candidates.push_back( next );
+				x += place.dx_;
+			}
+			y += place.dy_;
+		}
+		return candidates;
+	} );
+}
+
+struct zoom_path_t
+{
+	std::vector<asm_place_t> places_;	//	From INITIALPLACE
+	std::vector<double> diversities_;	//	Of the zoomed in screens
+	double score_ = 0;
+};
+
+//	Beam search over the zoom levels: keeps the beam best paths at each level,
+//	with at most per_first of them starting with the same zoom (so paths do not all
+//	share the best first zoom)
+std::vector<zoom_path_t> plan_zoom_paths( int beam, int per_first, const tile_pool_t &pool=tile_pool )
+{
+	std::vector<zoom_path_t> paths( 1 );
+	paths[0].places_.push_back( asm_place_t::initial() );
+
+	for (int zoom=1;zoom!=ZOOMLEVELS;zoom++)
+	{
+		std::vector<zoom_path_t> next;
+		for (auto &path:paths)
+			for (auto &place:zoom_candidates( path.places_.back() ))
+			{
+				next.push_back( path );
+				next.back().places_.push_back( place );
+			}
+
+		pool.run( next.size(), [&]( int k )
+		{
+			double d = screen_diversity( drawset_model( next[k].places_.back() ) );
+			next[k].diversities_.push_back( d );
+			next[k].score_ += d;
+		} );
+
+		//	Neighbouring pixels of a path and pixels of other paths can lead to the same place
+		std::stable_sort( next.begin(), next.end(), []( auto &a, auto &b ) { return a.score_>b.score_; } );
+		paths.clear();
+		std::set<std::pair<uint16_t,uint16_t>> seen;
+		std::map<std::pair<uint16_t,uint16_t>,int> firsts;
+		for (auto &path:next)
+		{
+			auto &first = path.places_[1];
+			if ((int)paths.size()<beam && firsts[{ first.x_, first.y_ }]<per_first &&
+				seen.insert( { path.places_.back().x_, path.places_.back().y_ } ).second)
+			{
+				firsts[{ first.x_, first.y_ }]++;
+				paths.push_back( path );
+			}
+		}
+
+		std::cerr << "Zoom level " << zoom << ": " << next.size() << " candidates, best score "
+			<< (paths.empty() ? 0 : paths[0].score_) << std::endl;
+	}
+	return paths;
 }
 
-char palette( int i )
+//	Checks that the emulated SELECTNEXT chooses the planned places
+bool check_zoom_path( cpu6502_t &cpu, const symbols_t &sym, const zoom_path_t &path )
 {
-	i /= 2;
-	const char *p = " .,'~=+:;[/<*?&o0x#";
-	if (i<3)
-		return ' ';
-	i -= 3;
-	if (i>=strlen(p))
-		return '#';
-	return p[i];
+	for (size_t k=1;k<path.places_.size();k++)
+	{
+		auto &place = path.places_[k-1];
+		auto &next = path.places_[k];
+		//	The pixel the next place is centered on
+		uint16_t x = next.x_ + SCREENWIDTH/2*next.dx_;
+		uint16_t y = next.y_ + SCREENHEIGHT/2*next.dy_;
+		cpu.set16( sym["X"], x );
+		cpu.set16( sym["Y"], y );
+		cpu.set16( sym["DX"], place.dx_ );
+		cpu.set16( sym["DY"], place.dy_ );
+		cpu.mem_[sym["ZOOMLEVEL"]] = place.zoom_;
+		cpu.mem_[sym["FREQ"]] = 0;	//	The first choice is always taken
+		cpu.call( sym["SELECTNEXT"] );
+		if (cpu.get16( sym["NEXTX"] )!=next.x_ || cpu.get16( sym["NEXTY"] )!=next.y_ ||
+			cpu.get16( sym["NEXTDX"] )!=next.dx_ || cpu.get16( sym["NEXTDY"] )!=next.dy_ ||
+			cpu.mem_[sym["NEXTZOOMLEVEL"]]!=next.zoom_)
+			return false;
+	}
+	return true;
 }
 
-void mandel( const place_t &place, ioutput &out )
+//	Prints the paths as ASM data: each place is the 9 bytes of NEXTX to NEXTZOOMLEVEL
+void print_zoom_paths( const std::vector<zoom_path_t> &paths )
 {
-	std::cout << place.description() << "\n";
-	out.output_start( place.description(), place.w_, place.h_ );
-	auto y = place.y_;
-	for (int i=0;i!=place.h_;i++)
+	auto bytes = []( uint16_t v )
 	{
-		auto x = place.x_;
-		for (int j=0;j!=place.w_;j++)
+		char buffer[16];
+		sprintf( buffer, "$%02X, $%02X", v & 0xff, v >> 8 );
+		return std::string( buffer );
+	};
+
+	std::cout << "; Zoom paths from INITIALPLACE, planned by 'validate plan'" << std::endl;
+	std::cout << "; Each place is NEXTX, NEXTY, NEXTDX, NEXTDY, NEXTZOOMLEVEL" << std::endl;
+	std::cout << "ZOOMPATHCOUNT = " << paths.size() << std::endl;
+	std::cout << "ZOOMPATHS:" << std::endl;
+	for (size_t k=0;k!=paths.size();k++)
+	{
+		auto &path = paths[k];
+		printf( "; Path %zu, diversity", k );
+		for (auto d:path.diversities_)
+			printf( " %.3f", d );
+		printf( "\n" );
+		for (size_t z=1;z<path.places_.size();z++)
 		{
-			int it = iter(x,y,x,y);
-			out.output( palette(it), x, y );
-			x = x + place.rx_;
+			auto &p = path.places_[z];
+			printf( "  .byte %s, %s, %s, %s, %d\n", bytes( p.x_ ).c_str(), bytes( p.y_ ).c_str(),
+				bytes( p.dx_ ).c_str(), bytes( p.dy_ ).c_str(), p.zoom_ );
 		}
-		y = y + place.ry_;
-		std::cout << i << " " << std::flush;
 	}
-	out.output_end();
-	std::cout << std::endl;
 }
 
-void mandelhr( const place_t &place, ioutput &out, const font_t &font )
+int plan_main( int count, int beam, const char *listing )
 {
-	auto placehr = place;
-	placehr.rx_ = place.rx_.div2();
-	placehr.ry_ = place.ry_.div2();
+	if (count<1 || beam<count)
+	{
+		std::cerr << "Usage: validate plan [paths] [beam] [listing], with 1 <= paths <= beam" << std::endl;
+		exit( 1 );
+	}
 
-	out.output_start( place.description(), place.w_, place.h_ );
-	auto y = place.y_;
-	for (int i=0;i!=place.h_;i++)
+	auto paths = plan_zoom_paths( beam, std::max( 1, beam/count ) );
+
+	//	Best paths first, preferring a different first zoom for each
+	std::vector<zoom_path_t> chosen;
+	std::vector<bool> taken( paths.size() );
+	std::set<std::pair<uint16_t,uint16_t>> firsts;
+	for (size_t k=0;k!=paths.size() && (int)chosen.size()<count;k++)
+		if (firsts.insert( { paths[k].places_[1].x_, paths[k].places_[1].y_ } ).second)
+			chosen.push_back( paths[k] ), taken[k] = true;
+	for (size_t k=0;k!=paths.size() && (int)chosen.size()<count;k++)
+		if (!taken[k])
+			chosen.push_back( paths[k] );
+	std::stable_sort( chosen.begin(), chosen.end(), []( auto &a, auto &b ) { return a.score_>b.score_; } );
+
+	symbols_t sym;
+	cpu6502_t cpu;
+	emu_setup( cpu, sym, listing );
+	for (auto &path:chosen)
+		if (!check_zoom_path( cpu, sym, path ))
+		{
+			std::cerr << "SELECTNEXT does not choose the planned places" << std::endl;
+			exit( 1 );
+		}
+
+	print_zoom_paths( chosen );
+	return 0;
+}
+
+//	Prints the reuse maps of the best planned path as ASM data, and checks them
+//	A point can only be reused if it escaped: MAXITER grows with the zoom level
+int reuse_main()
+{
+	auto path = plan_zoom_paths( PLAN_BEAM, PLAN_BEAM/PLAN_PATHS )[0];
+
+	auto bytes = []( const std::vector<int> &vs )
 	{
-		auto x = place.x_;
-		for (int j=0;j!=place.w_;j++)
+		std::string s;
+		for (auto v:vs)
 		{
-			auto x0 = x;
-			auto y0 = y;
-			auto x1 = x + placehr.rx_;
-			auto y1 = y + placehr.ry_;
+			char buffer[8];
+			sprintf( buffer, "%s$%02X", s.empty() ? "" : ",", v & 0xff );
+			s += buffer;
+		}
+		return s;
+	};
 
-			int it0 = iter(x0,y0,x0,y0);
-			int it1 = iter(x1,y0,x0,y1);
-			int it2 = iter(x0,y1,x1,y0);
-			int it3 = iter(x1,y1,x1,y1);
+	std::cout << "; Reuse maps of the best planned path, by 'validate reuse'" << std::endl;
+	std::cout << "; For each column (row) of a screen, the column (row) of the previous screen, or $FF" << std::endl;
+	for (size_t z=1;z<path.places_.size();z++)
+	{
+		auto &place = path.places_[z-1];
+		auto &next = path.places_[z];
+		auto map = reuse_map_model( place, next );
+
+		//	Counts of the previous screen, in the order of DRAWSET
+		const zoomlevel_t &level = zoomlevels[place.zoom_];
+		int its[SCREENHEIGHT][SCREENWIDTH];
+		for (int i=0;i!=SCREENHEIGHT;i++)
+			for (int j=0;j!=SCREENWIDTH;j++)
+				its[i][j] = iter_asm( place.x_+j*place.dx_, place.y_+i*place.dy_, level.maxiter_ );
+
+		int reused = 0;
+		for (int i=0;i!=SCREENHEIGHT;i++)
+			for (int j=0;j!=SCREENWIDTH;j++)
+			{
+				int i0 = map.rows_[i];
+				int j0 = map.cols_[j];
+				if (i0<0 || j0<0 || its[i0][j0]==level.maxiter_)
+					continue;
+				int it = iter_asm( next.x_+j*next.dx_, next.y_+i*next.dy_, zoomlevels[next.zoom_].maxiter_ );
+				if (it!=its[i0][j0])
+				{
+					std::cerr << "Reused count differs at " << i << "," << j << " of zoom level " << next.zoom_ << std::endl;
+					exit( 1 );
+				}
+				reused++;
+			}
 
-			out.output( font.best( it0, it1, it2, it3 ), x, y );		
+		printf( "; Zoom level %d: %d lattice points shared, %d reused (DX $%04X -> $%04X, DY $%04X -> $%04X)\n",
+			next.zoom_, map.reused(), reused, place.dx_, next.dx_, place.dy_, next.dy_ );
+		std::cout << "REUSECOLS" << next.zoom_ << ":" << std::endl << "  .byte " << bytes( map.cols_ ) << std::endl;
+		std::cout << "REUSEROWS" << next.zoom_ << ":" << std::endl << "  .byte " << bytes( map.rows_ ) << std::endl;
+	}
+	return 0;
+}
+
+//	-----------------------------------------------------------------------------
+//	Julia parameter sweep
+//	-----------------------------------------------------------------------------
+
+//	The Julia set of c is connected when the critical orbit (0, c, c^2+c...) does
+//	not escape. Below this count, the set is thin dust and is not rendered
+const int JULIA_MIN_CRITICAL=12;
+//	A connected set is only rendered if c is this close (in epsilons) to a c whose
+//	critical orbit escapes: further inside the Mandelbrot set, it is a dull blob
+const int JULIA_REACH=4;
+const int JULIA_STEP=8;			//	Epsilons between two c of the grid
+const int JULIA_SHEET_COLUMNS=8;
+const int JULIA_SHEET_ROWS=6;
+
+struct julia_candidate_t
+{
+	fixed_t cx_;
+	fixed_t cy_;
+	int critical_ = 0;			//	Iterations of the critical orbit
+	std::vector<uint8_t> its_;
+	double diversity_ = 0;
+};
 
-			x = x + place.rx_;
+//	c over the area of the Mandelbrot set, with cy >= 0 only (the set of the
+//	conjugate of c is the mirror image)
+std::vector<julia_candidate_t> julia_grid( int step )
+{
+	std::vector<julia_candidate_t> cs;
+	for (int y=0;y<=320;y+=step)
+		for (int x=-512;x<=128;x+=step)
+		{
+			julia_candidate_t c;
+			c.cx_ = packed_t::epsilon( x );
+			c.cy_ = packed_t::epsilon( y );
+			cs.push_back( c );
 		}
-		y = y + place.ry_;
-		std::cout << i << " " << std::flush;
+	return cs;
+}
+
+//	Critical orbit quick test: the sets of c that are dust or dull blobs are skipped
+bool julia_worth( julia_candidate_t &c, int min_critical, int reach )
+{
+	c.critical_ = iter<packed_t>( c.cx_, c.cy_, c.cx_, c.cy_ );
+	if (c.critical_<min_critical)
+		return false;
+	if (c.critical_<ITER_MAX || reach==0)
+		return true;
+	packed_t r = packed_t::epsilon( reach );
+	packed_t x = c.cx_, y = c.cy_;
+	std::pair<packed_t,packed_t> around[] = { { x+r, y }, { x-r, y }, { x, y+r }, { x, y-r } };
+	for (auto [ax,ay]:around)
+		if (iter( ax, ay, ax, ay )<ITER_MAX)
+			return true;
+	return false;
+}
+
+//	Renders the Julia sets of every c of cs that passes julia_worth, all at once on the pool
+//	Returns the rendered ones, with their iteration counts and screen diversity
+std::vector<julia_candidate_t> julia_sweep( const place_t &place, std::vector<julia_candidate_t> cs, int min_critical, int reach, const tile_pool_t &pool=tile_pool )
+{
+	std::vector<julia_candidate_t> kept;
+	for (auto &c:cs)
+	{
+		if (julia_worth( c, min_critical, reach ))
+		{
+			c.its_.resize( place.w_*place.h_ );
+			kept.push_back( c );
+		}
+	}
+
+	lattice_t<packed_t> l( place );
+	render_batch_tiles( kept.size(), place.w_, place.h_, [&]( int k, int i, int j0, int j1 )
+	{
+		std::array<packed_t,TILE_W> tcx, tcy, y;
+		tcx.fill( kept[k].cx_ );
+		tcy.fill( kept[k].cy_ );
+		y.fill( l.ys_[i] );
+		iter_span( tcx.data(), tcy.data(), &l.xs_[j0], y.data(), j1-j0, &kept[k].its_[i*place.w_+j0] );
+	}, pool );
+
+	for (auto &c:kept)
+	{
+		std::string s;
+		for (int it:c.its_)
+			s += palette( it );
+		c.diversity_ = screen_diversity( s );
 	}
+	return kept;
+}
+
+//	All the sets side by side in a single image, columns x rows of them
+//	Each one is labelled with its c by img_output
+void julia_sheet( const place_t &place, const std::vector<julia_candidate_t> &cs, int columns, int rows, ioutput &out )
+{
+	out.output_start( "Julia sweep", columns*place.w_, rows*place.h_ );
+	for (int i=0;i!=rows*place.h_;i++)
+		for (int j=0;j!=columns*place.w_;j++)
+		{
+			size_t k = i/place.h_*columns+j/place.w_;
+			if (k<cs.size())
+				out.output( palette( cs[k].its_[i%place.h_*place.w_+j%place.w_] ), cs[k].cx_, cs[k].cy_ );
+			else
+				out.output( ' ', fixed_t(0), fixed_t(0) );
+		}
 	out.output_end();
-	std::cout << std::endl;
 }
 
+//	Checks the sweep against iter, and the critical orbit filter
+void test_julia_sweep()
+{
+	place_t place( 0,0,25,40 );
+	std::vector<julia_candidate_t> cs( 4 );
+	std::pair<double,double> julias[] = { { -0.8, 0.156 }, { -0.55, -0.64 }, { 0.27, 1.0/256 }, { 0.5, 0.5 } };
+	for (int k=0;k!=4;k++)
+	{
+		cs[k].cx_ = julias[k].first;
+		cs[k].cy_ = julias[k].second;
+	}
+	auto kept = julia_sweep( place, cs, JULIA_MIN_CRITICAL, 0 );
+	assert( kept.size()==3 && kept[2].cx_==fixed_t(0.27) );
+	assert( julia_sweep( place, { cs[2], julia_candidate_t() }, JULIA_MIN_CRITICAL, JULIA_REACH ).size()==1 );
+	lattice_t<packed_t> l( place );
+	for (auto &c:kept)
+	{
+		assert( c.diversity_>0 );
+		for (int i=0;i!=place.h_;i++)
+			for (int j=0;j!=place.w_;j++)
+				assert( c.its_[i*place.w_+j]==iter<packed_t>( c.cx_, c.cy_, l.xs_[j], l.ys_[i] ) );
+	}
+}
 
-void julia( const place_t &place, fixed_t cx, fixed_t cy, ioutput &out )
+//	Sweeps the grid of c, and writes a contact sheet of the most diverse sets
+//	Prints them in order, with c in ASM format
+int julias_main( int step, int count )
 {
-	out.output_start( place.description(), place.w_, place.h_ );
-	auto y = place.y_;
-	for (int i=0;i!=place.h_;i++)
+	if (step<=0 || count<=0)
 	{
-		auto x = place.x_;
-		for (int j=0;j!=place.w_;j++)
+		std::cerr << "Invalid step " << step << " or count " << count << std::endl;
+		exit(1);
+	}
+
+	place_t place( 0,0,25,40 );
+	auto cs = julia_grid( step );
+	auto start = std::chrono::steady_clock::now();
+	auto kept = julia_sweep( place, cs, JULIA_MIN_CRITICAL, JULIA_REACH );
+	double s = std::chrono::duration<double>( std::chrono::steady_clock::now()-start ).count();
+	std::stable_sort( kept.begin(), kept.end(), []( auto &a, auto &b ) { return a.diversity_>b.diversity_; } );
+	printf( "Julia sweep: %zu c, %zu skipped (dust or blob), %zu rendered in %.3f s\n",
+		cs.size(), cs.size()-kept.size(), kept.size(), s );
+	if (kept.empty())
+	{
+		std::cout << "No julia set kept, no contact sheet written" << std::endl;
+		return 0;
+	}
+
+	kept.resize( std::min<size_t>( kept.size(), count ) );
+	for (size_t k=0;k!=kept.size();k++)
+		std::cout << k << " " << kept[k].cx_ << " " << kept[k].cy_ << " critical= " << kept[k].critical_
+			<< " diversity= " << kept[k].diversity_ << " " << kept[k].cx_.as_asm() << " " << kept[k].cy_.as_asm() << std::endl;
+
+	font_t font("s2513.d2");
+	img_output out( font );
+	int columns = std::min<int>( JULIA_SHEET_COLUMNS, kept.size() );
+	julia_sheet( place, kept, columns, (kept.size()+columns-1)/columns, out );
+	return 0;
+}
+
+//	-----------------------------------------------------------------------------
+//	Demo sequence
+//	-----------------------------------------------------------------------------
+
+const int Y4M_LINES=4;			//	Text lines drawn per video frame
+const int Y4M_HOLD=6;			//	Video frames of each finished screen
+const int DEMO_SCREENS=16;
+const char *DEMO_NAME = "/tmp/mandel.y4m";
+
+//	Writes the screens as a monochrome YUV4MPEG2 stream, drawn a few lines per frame
+//	(for ffplay or ffmpeg)
+class y4m_output : public ioutput
+{
+	const font_t &font_;
+	std::ofstream ofs_;
+	std::vector<uint8_t> frame_;
+	int width_;
+	int x_ = 0;
+	int y_ = 0;
+
+	void write_frame()
+	{
+		ofs_ << "FRAME\n";
+		ofs_.write( (const char *)frame_.data(), frame_.size() );
+	}
+public:
+	y4m_output( const font_t &font, const char *filename, int w=SCREENWIDTH, int h=SCREENHEIGHT ) : font_(font), ofs_(filename, std::ios::binary), frame_(w*8*h*8), width_(w*8)
+	{
+		if (!ofs_)
 		{
-			int it = iter(cx,cy,x,y);
-			out.output( palette(it), x, y );
-			x = x + place.rx_;
+			std::cerr << "Cannot open file " << filename << std::endl;
+			exit(1);
 		}
-		y = y + place.ry_;
-		std::cout << i << " " << std::flush;
+		ofs_ << "YUV4MPEG2 W" << w*8 << " H" << h*8 << " F6:1 Ip A1:1 Cmono\n";
 	}
-	out.output_end();
-	std::cout << std::endl;
+
+	virtual void do_output_start( const std::string s )
+	{
+		x_ = y_ = 0;
+		std::fill( frame_.begin(), frame_.end(), 16 );
+	}
+
+	//	Set pixels are white, as in img_output
+	virtual void do_output( char c, fixed_t fx, fixed_t fy )
+	{
+		auto p = font_.get( c );
+		for (int i=0;i!=8;i++)
+			for (int j=0;j!=8;j++)
+				frame_[(y_*8+i)*width_+x_*8+j] = (p[i]<<j)&0x80 ? 235 : 16;
+		if (++x_==w_)
+		{
+			x_ = 0;
+			if (++y_%Y4M_LINES==0 || y_==h_)
+				write_frame();
+		}
+	}
+
+	virtual void do_output_end()
+	{
+		for (int k=0;k!=Y4M_HOLD;k++)
+			write_frame();
+	}
+};
+
+//	Replays MANDELAUTO from a seed, and writes the screens as a video
+//	Each screen is encoded while the next one is computed
+int demo_main( int seed, int screens, const char *filename )
+{
+	if (seed<0 || seed>255 || screens<=0)
+	{
+		std::cerr << "Invalid seed " << seed << " or screen count " << screens << std::endl;
+		exit(1);
+	}
+
+	font_t font("s2513.d2");
+	y4m_output out( font, filename );
+	auto start = std::chrono::steady_clock::now();
+	demo_screen_t screen = demo_screen_model( asm_place_t::initial(), seed );
+	for (int k=0;k!=screens;k++)
+	{
+		demo_screen_t next;
+		std::thread compute( [&]()
+		{
+			if (k+1!=screens)
+				next = demo_screen_model( screen.next_, screen.seed_ );
+		} );
+
+		auto &p = screen.place_;
+		printf( "%d: ZOOMLEVEL %d X0=%04X Y0=%04X DX=%04X DY=%04X\n", k, p.zoom_, p.x_, p.y_, p.dx_, p.dy_ );
+		out.output_start( "", SCREENWIDTH, SCREENHEIGHT );
+		for (char c:screen.chars_)
+			out.output( c, fixed_t(0), fixed_t(0) );
+		out.output( ' ', fixed_t(0), fixed_t(0) );
+		out.output_end();
+
+		compute.join();
+		screen = next;
+	}
+	double s = std::chrono::duration<double>( std::chrono::steady_clock::now()-start ).count();
+	printf( "%d screens in %.3f s, written to %s\n", screens, s, filename );
+	return 0;
+}
+
+//	-----------------------------------------------------------------------------
+//	Seed space
+//	-----------------------------------------------------------------------------
+
+//	MANDELAUTO only depends on SEED: a run zooms in from INITIALPLACE until
+//	SELECTNEXT picks nothing, and the next run starts with the SEED left by the
+//	last DRAWSET. So there are 256 runs, all simulated here with the model:
+//	the 255 of the LFSR, and SEED 0, which the INC SEED of the key wait and of an
+//	abort can reach, and which RANDOM never leaves (each RNDCHOICE then does 256
+//	down counts)
+
+const double SEEDS_DULL=0.45;	//	Diversity under which a zoomed in screen is dull
+const int SEEDS_WORST=8;		//	Seeds listed in each ranking
+
+//	The screens of the run of a seed
+struct seed_run_t
+{
+	uint8_t seed_;
+	std::vector<demo_screen_t> screens_;
+	std::vector<double> diversities_;	//	screen_diversity of each screen
+	int iterations_ = 0;				//	Of all the screens
+	int dull_ = 0;						//	Zoomed in screens under SEEDS_DULL
+
+	//	SEED at the start of the next run
+	uint8_t next_seed() const { return screens_.back().seed_; }
+};
+
+//	Chains demo_screen_model until the next place is at zoom level 0
+//	(SELECTNEXT always zooms in, so a run has at most ZOOMLEVELS screens)
+seed_run_t seed_run_model( uint8_t seed )
+{
+	seed_run_t run;
+	run.seed_ = seed;
+	auto place = asm_place_t::initial();
+	do
+	{
+		run.screens_.push_back( demo_screen_model( place, seed ) );
+		auto &screen = run.screens_.back();
+		run.diversities_.push_back( screen_diversity( screen.chars_ ) );
+		run.iterations_ += screen.iterations_;
+		if (place.zoom_ && run.diversities_.back()<SEEDS_DULL)
+			run.dull_++;
+		place = screen.next_;
+		seed = screen.seed_;
+	} while (place.zoom_);
+	return run;
+}
+
+//	The runs of every seed, indexed by seed, one job per seed
+std::vector<seed_run_t> explore_seeds( const tile_pool_t &pool=tile_pool )
+{
+	std::vector<seed_run_t> runs( 256 );
+	pool.run( runs.size(), [&]( int k ) { runs[k] = seed_run_model( k ); } );
+	return runs;
+}
+
+//	The demo ends up looping on the cycles of the seed -> next seed map
+//	Returns the length of each cycle
+std::vector<int> seed_cycles( const std::vector<seed_run_t> &runs )
+{
+	std::vector<int> cycles;
+	std::vector<int> state( 256, 0 );	//	0: not seen, 1: on the current path, 2: done
+	for (int s=0;s!=256;s++)
+	{
+		int t = s;
+		while (!state[t])
+		{
+			state[t] = 1;
+			t = runs[t].next_seed();
+		}
+		if (state[t]==1)
+		{
+			int n = 0;
+			int u = t;
+			do
+			{
+				n++;
+				u = runs[u].next_seed();
+			} while (u!=t);
+			cycles.push_back( n );
+		}
+		for (t=s;state[t]==1;t=runs[t].next_seed())
+			state[t] = 2;
+	}
+	return cycles;
+}
+
+//	Checks the runs against chained demo_screen_model calls
+void test_seed_runs()
+{
+	auto runs = explore_seeds();
+	for (int s:{ 0, 1, 0x5A, 0xFF })
+	{
+		auto &run = runs[s];
+		uint8_t seed = s;
+		auto place = asm_place_t::initial();
+		int iterations = 0;
+		for (auto &screen:run.screens_)
+		{
+			auto expected = demo_screen_model( place, seed );
+			assert( screen.chars_==expected.chars_ && screen.seed_==expected.seed_ );
+			iterations += screen.iterations_;
+			place = screen.next_;
+			seed = screen.seed_;
+		}
+		assert( iterations==run.iterations_ && run.seed_==s );
+		assert( place.x_==asm_place_t::initial().x_ && place.dx_==asm_place_t::initial().dx_ );
+	}
+
+	//	The first screen is the same for every seed, so is its cost
+	int first = demo_screen_model( asm_place_t::initial(), 1 ).iterations_;
+	for (auto &run:runs)
+		assert( run.screens_[0].iterations_==first && run.screens_.size()<=ZOOMLEVELS );
+
+	//	SEED 0 stays 0: a cycle of its own
+	assert( runs[0].next_seed()==0 );
+	int total = 0;
+	for (int n:seed_cycles( runs ))
+		total += n;
+	assert( total>1 && total<=256 );
+}
+
+//	Simulates the 256 runs, prints the iterations of the screens of each zoom level,
+//	the slowest screen (with its cycles on the emulator), the slowest and the dullest
+//	runs, and the cycles the demo ends up looping on
+int seeds_main( const char *listing )
+{
+	auto start = std::chrono::steady_clock::now();
+	auto runs = explore_seeds();
+	double seconds = std::chrono::duration<double>( std::chrono::steady_clock::now()-start ).count();
+	printf( "%zu runs in %.3f s (%d threads)\n\n", runs.size(), seconds, tile_pool.threads() );
+
+	printf( "ZOOMLEVEL  screens  iterations: min  median     p90     max\n" );
+	for (int zoom=0;zoom!=ZOOMLEVELS;zoom++)
+	{
+		std::vector<int> its;
+		for (auto &run:runs)
+			if (zoom<(int)run.screens_.size())
+				its.push_back( run.screens_[zoom].iterations_ );
+		if (its.empty())
+			continue;
+		std::sort( its.begin(), its.end() );
+		printf( "%9d  %7zu  %15d %7d %7d %7d\n", zoom, its.size(), its.front(), its[its.size()/2],
+			its[its.size()*9/10], its.back() );
+	}
+
+	const seed_run_t *worst_run = &runs[0];
+	const demo_screen_t *worst = &runs[0].screens_[0];
+	for (auto &run:runs)
+		for (auto &screen:run.screens_)
+			if (screen.iterations_>worst->iterations_)
+				worst = &screen, worst_run = &run;
+	auto &p = worst->place_;
+	printf( "\nSlowest screen: seed $%02X, ZOOMLEVEL %d X0=%04X Y0=%04X DX=%04X DY=%04X, %d iterations\n",
+		worst_run->seed_, p.zoom_, p.x_, p.y_, p.dx_, p.dy_, worst->iterations_ );
+	symbols_t sym;
+	cpu6502_t cpu;
+	emu_setup( cpu, sym, listing );
+	uint64_t cycles = cpu.cycles_;
+	emu_drawset( cpu, sym, p );
+	cycles = cpu.cycles_-cycles;
+	printf( "DRAWSET on the emulator: %llu cycles (%.1f s at 1 MHz)\n", (unsigned long long)cycles, cycles/1e6 );
+
+	auto print_run = []( const seed_run_t *run )
+	{
+		printf( "  $%02X: %zu screens, %7d iterations, diversity", run->seed_, run->screens_.size(), run->iterations_ );
+		for (auto d:run->diversities_)
+			printf( " %.3f", d );
+		printf( "\n" );
+	};
+	//	Prints the first SEEDS_WORST runs in the order of better
+	auto print_ranked = [&]( std::vector<const seed_run_t *> rs, auto better )
+	{
+		std::stable_sort( rs.begin(), rs.end(), better );
+		for (size_t k=0;k!=rs.size() && k!=SEEDS_WORST;k++)
+			print_run( rs[k] );
+	};
+	std::vector<const seed_run_t *> all;
+	for (auto &run:runs)
+		all.push_back( &run );
+
+	printf( "\nSeed $00 (RANDOM stays 0, reached by INC SEED wrapping)%s:\n",
+		runs[0].next_seed()==0 ? ", replays the same run forever" : "" );
+	print_run( &runs[0] );
+
+	printf( "\nSlowest runs:\n" );
+	print_ranked( all, []( auto a, auto b ) { return a->iterations_>b->iterations_; } );
+
+	std::vector<const seed_run_t *> dull;
+	for (auto &run:runs)
+		if (run.dull_)
+			dull.push_back( &run );
+	printf( "\n%zu runs with dull screens (diversity under %.2f)%s\n", dull.size(), SEEDS_DULL, dull.empty() ? "" : ":" );
+	auto dullest = []( const seed_run_t *run ) { return *std::min_element( run->diversities_.begin(), run->diversities_.end() ); };
+	print_ranked( dull, [&]( auto a, auto b ) { return a->dull_>b->dull_ || (a->dull_==b->dull_ && dullest( a )<dullest( b )); } );
+
+	int lengths[ZOOMLEVELS+1] = {};
+	for (auto &run:runs)
+		lengths[run.screens_.size()]++;
+	printf( "\nRun lengths:" );
+	for (int n=1;n<=ZOOMLEVELS;n++)
+		if (lengths[n])
+			printf( " %d runs of %d screens", lengths[n], n );
+	printf( "\n" );
+
+	auto cycle_lengths = seed_cycles( runs );
+	printf( "The demo ends up looping on %zu cycles of runs, of lengths", cycle_lengths.size() );
+	for (int n:cycle_lengths)
+		printf( " %d", n );
+	printf( "\n" );
+	return 0;
+}
+
+//	-----------------------------------------------------------------------------
+//	Comparison of fixed point formats
+//	-----------------------------------------------------------------------------
+
+//	Zoom center for the precision comparison (in the seahorse valley)
+const double FORMATS_X = -0.743643887;
+const double FORMATS_Y = 0.131825904;
+const int FORMATS_DEPTHS = 48;
+
+//	iter with the escape rule of the ASM format whatever the format: a point escapes
+//	when zx^2+zy^2 reaches 8, or after the iteration where (zx-zy)^2 (from mul2) does
+//	(iter escapes on overflows, which happen at 2^ISIZE: 8 for 3.x, 16 for 4.x and
+//	32 for 5.11, so the formats would also differ by the escape rule)
+template <typename F>
+int format_iter( F x, F y )
+{
+	const F limit = F::from_magnitude( false, typename F::magnitude_t(1) << (3+F::FSIZE) );
+	auto escaped = [&]( const F &v ) { return v.is_nan() || !(v < limit); };
+	F zx = x;
+	F zy = y;
+	F zx2 = zx.squared();
+	F zy2 = zy.squared();
+	int i = 0;
+	while (i < ITER_MAX && !escaped( zx2 + zy2 ))
+	{
+		F xmy2 = (zx - zy).squared();
+		i++;
+		if (escaped( xmy2 ))
+			break;
+		zy = -xmy2 + zx2 + zy2 + y;
+		zx = zx2 - zy2 + x;
+		zx2 = zx.squared();
+		zy2 = zy.squared();
+	}
+	return i;
+}
+
+//	On 3.8 format_iter is iter, on the other formats it escapes no later
+template <typename F>
+void test_format_iter()
+{
+	typedef typename F::real_t real_t;
+	for (int y=-24;y<=24;y+=2)
+		for (int x=-40;x<=16;x+=2)
+		{
+			F fx = real_t( x/16.0 );
+			F fy = real_t( y/16.0+1/1024.0 );
+			int its = format_iter( fx, fy );
+			if (F::ISIZE==fixed_t::ISIZE && F::FSIZE==fixed_t::FSIZE)
+				assert( its==iter( fx, fy, fx, fy, false ) );
+			else
+				assert( its<=iter( fx, fy, fx, fy, false ) );
+		}
+}
+
+//	Characters of a 40x24 screen zoomed in depth times (by 2) on the formats center
+template <typename F>
+std::string format_screen( int depth )
+{
+	typedef typename F::real_t real_t;
+	double r = 3.0/SCREENWIDTH;
+	for (int d=0;d!=depth;d++)
+		r /= 2;
+	std::string s;
+	for (int i=0;i!=SCREENHEIGHT;i++)
+		for (int j=0;j!=SCREENWIDTH;j++)
+		{
+			F x = real_t( FORMATS_X+(j-SCREENWIDTH/2)*r );
+			F y = real_t( FORMATS_Y+(i-SCREENHEIGHT/2)*r );
+			s += palette( format_iter( x, y ) );
+		}
+	return s;
+}
+
+//	Prints a line of the comparison: square table size, speed of iter, and the
+//	deepest zoom where at least 90% of the characters match the deepest format
+//	(the screens use format_iter, so every format escapes as 3.8 does)
+template <typename F>
+void format_report( const char *name, const std::vector<std::string> &reference )
+{
+	typedef typename F::wide_t wide_t;
+
+	//	Entries of a table limited to the squares that do not overflow
+	//	(the ASM table has all 2^11 entries, half of them NaN)
+	wide_t limit = wide_t(1) << (F::ISIZE+2*F::FSIZE);
+	wide_t lo = 0, hi = wide_t(1) << ((F::ISIZE+2*F::FSIZE+1)/2+1);
+	while (hi-lo>1)
+	{
+		wide_t mid = (lo+hi)/2;
+		(mid*mid<limit ? lo : hi) = mid;
+	}
+	double entries = (double)(lo+1);
+	int entry_bytes = F::ISIZE+F::FSIZE+2<=16 ? 2 : F::ISIZE+F::FSIZE+2<=32 ? 4 : 8;
+
+	//	Speed, on the first screen
+	std::vector<F> points;
+	double iterations = 0;
+	double r = 3.0/SCREENWIDTH;
+	for (int i=0;i!=SCREENHEIGHT;i++)
+		for (int j=0;j!=SCREENWIDTH;j++)
+		{
+			F x = typename F::real_t( FORMATS_X+(j-SCREENWIDTH/2)*r );
+			F y = typename F::real_t( FORMATS_Y+(i-SCREENHEIGHT/2)*r );
+			points.push_back( x );
+			points.push_back( y );
+			iterations += iter( x, y, x, y );
+		}
+	auto speed = bench( name, iterations, [&]()
+	{
+		int sink = 0;
+		for (size_t k=0;k<points.size();k+=2)
+			sink += iter( points[k], points[k+1], points[k], points[k+1] );
+		bench_sink = sink;
+	} );
+
+	//	Stops when neighbour points can no longer be told apart
+	int depth = -1;
+	double step = 3.0/SCREENWIDTH;
+	for (int d=0;d!=FORMATS_DEPTHS;d++,step/=2)
+	{
+		if (F(typename F::real_t(FORMATS_X+step))==F(typename F::real_t(FORMATS_X)))
+			break;
+		auto s = format_screen<F>( d );
+		int same = 0;
+		for (size_t k=0;k!=s.size();k++)
+			same += s[k]==reference[d][k];
+		if (same*10<(int)s.size()*9)
+			break;
+		depth = d;
+	}
+
+	printf( "%-6s %4d %12.4g %14.4g %10.2f %6d\n", name, F::ISIZE+F::FSIZE, entries, entries*entry_bytes,
+		speed.percentile( 0.5 )*1e9/speed.ops_, depth );
+}
+
+//	Compares the fixed point formats, to choose one for a rewrite of the ASM
+int formats_main()
+{
+	std::vector<std::string> reference;
+	for (int d=0;d!=FORMATS_DEPTHS;d++)
+		reference.push_back( format_screen<fixed_4_56_t>( d ) );
+
+	printf( "Depth with the 3.8 escape rule for every format (escape when a square reaches 8)\n" );
+	printf( "Format bits squares        table bytes    ns/iter  depth\n" );
+	format_report<fixed_t>( "3.8", reference );
+	format_report<fixed_3_9_t>( "3.9", reference );
+	format_report<fixed_4_12_t>( "4.12", reference );
+	format_report<fixed_5_11_t>( "5.11", reference );
+	format_report<fixed_4_28_t>( "4.28", reference );
+	format_report<fixed_4_56_t>( "4.56", reference );
+	return 0;
+}
+
+//	-----------------------------------------------------------------------------
+//	Deep zoom
+//	-----------------------------------------------------------------------------
+
+//	Renders a zoom on (x,y), one frame every DEEP_FRAME halvings down to depth,
+//	into the same images as the normal run
+int deep_main( const char *xs, const char *ys, int depth, int maxiter )
+{
+	dd_t x, y;
+	if (!dd_t::parse( xs, x ) || !dd_t::parse( ys, y ))
+	{
+		std::cerr << "Invalid coordinates " << xs << " " << ys << std::endl;
+		exit(1);
+	}
+	if (maxiter<=0 || depth<0)
+	{
+		std::cerr << "Invalid depth " << depth << " or maxiter " << maxiter << std::endl;
+		exit(1);
+	}
+
+	font_t font("s2513.d2");
+	img_output out( font );
+	double r = 3.0/SCREENWIDTH;
+	for (int d=0;d<=depth;d++,r/=2)
+	{
+		if (d%DEEP_FRAME)
+			continue;
+		auto start = std::chrono::steady_clock::now();
+		auto stats = mandel_deep( deep_place_t( x, y, r, r ), maxiter, out );
+		double s = std::chrono::duration<double>( std::chrono::steady_clock::now()-start ).count();
+		print_deep_stats( stats );
+		printf( "Depth %d: %.3f s, %.2f ns/iteration\n", d, s, s*1e9/std::max<uint64_t>( 1, stats.iterations_ ) );
+	}
+	return 0;
 }
 
 //	Generates test cases for the ASM version of ADD and SUB
@@ -885,8 +6401,40 @@ void gen_tests()
 
 int main( int argc, char **argv )
 {
-
-	if (argc==2)
+	//	"validate cache" does the normal run with a persistent iteration cache
+	std::unique_ptr<iter_cache_t> cache;
+	if (argc==2 && !strcmp(argv[1],"cache"))
+		cache = std::make_unique<iter_cache_t>( ITER_CACHE_BITS, ITER_CACHE_NAME );
+
+	if (argc>=2 && !strcmp(argv[1],"emu"))
+		return emu_main( argc>=3 ? argv[2] : BINARY_NAME, argc>=4 ? argv[3] : LISTING_NAME );
+	if (argc>=2 && !strcmp(argv[1],"profile"))
+		return profile_main( argc>=3 ? argv[2] : LISTING_NAME, argc>=4 ? argv[3] : BINARY_NAME );
+	if (argc==2 && !strcmp(argv[1],"bench"))
+		return bench_main();
+	if (argc>=2 && !strcmp(argv[1],"plan"))
+		return plan_main( argc>=3 ? atoi(argv[2]) : PLAN_PATHS, argc>=4 ? atoi(argv[3]) : PLAN_BEAM,
+			argc>=5 ? argv[4] : LISTING_NAME );
+	if (argc==2 && !strcmp(argv[1],"formats"))
+		return formats_main();
+	if (argc>=2 && !strcmp(argv[1],"deep"))
+		return deep_main( argc>=4 ? argv[2] : DEEP_X, argc>=4 ? argv[3] : DEEP_Y,
+			argc>=5 ? atoi(argv[4]) : DEEP_DEPTH, argc>=6 ? atoi(argv[5]) : DEEP_MAXITER );
+	if (argc>=2 && !strcmp(argv[1],"julias"))
+		return julias_main( argc>=3 ? atoi(argv[2]) : JULIA_STEP, argc>=4 ? atoi(argv[3]) : JULIA_SHEET_COLUMNS*JULIA_SHEET_ROWS );
+	if (argc>=2 && !strcmp(argv[1],"demo"))
+		return demo_main( argc>=3 ? atoi(argv[2]) : 1, argc>=4 ? atoi(argv[3]) : DEMO_SCREENS, argc>=5 ? argv[4] : DEMO_NAME );
+	if (argc==2 && !strcmp(argv[1],"palette"))
+		return palette_main();
+	if (argc>=2 && !strcmp(argv[1],"seeds"))
+		return seeds_main( argc>=3 ? argv[2] : LISTING_NAME );
+	if (argc==2 && !strcmp(argv[1],"reuse"))
+		return reuse_main();
+	if (argc>=2 && !strcmp(argv[1],"diff"))
+		return diff_main( argc>=3 ? atoi(argv[2]) : 1, argc>=4 ? atoi(argv[3]) : ZOOMLEVELS-1,
+			argc>=5 ? argv[4] : LISTING_NAME );
+
+	if (argc==2 && !cache)
 	{
 		fixed_t f(atof(argv[1]));
 		std::cout << f.as_asm() << std::endl;
@@ -895,7 +6443,37 @@ int main( int argc, char **argv )
 
 	iter(fixed_t(-1.5),fixed_t(-1),fixed_t(-1.5),fixed_t(-1));
 
-	test_fixed();
+	test_fixed<fixed_t>();
+	test_fixed<fixed_3_9_t>();
+	test_fixed<fixed_4_12_t>();
+	test_fixed<fixed_5_11_t>();
+	test_fixed<fixed_4_28_t>();
+	test_fixed<fixed_4_56_t>();
+	test_packed();
+	test_squaretable();
+	test_iter();
+	test_iter_format<fixed_3_9_t>();
+	test_iter_format<fixed_4_12_t>();
+	test_iter_format<fixed_5_11_t>();
+	test_iter_format<fixed_4_28_t>();
+	test_iter_format<fixed_4_56_t>();
+	test_format_iter<fixed_t>();
+	test_format_iter<fixed_3_9_t>();
+	test_format_iter<fixed_4_12_t>();
+	test_format_iter<fixed_5_11_t>();
+	test_format_iter<fixed_4_28_t>();
+	test_format_iter<fixed_4_56_t>();
+	test_iter_row();
+	test_palette_row();
+	test_iter_asm();
+	test_load_lst();
+	test_cpu6502();
+	test_iter_cache();
+	test_mapped_file();
+	test_deep();
+	test_julia_sweep();
+	test_demo_model();
+	test_seed_runs();
 
 
 	gen_tests();
@@ -950,6 +6528,10 @@ int main( int argc, char **argv )
 
 	font_t font("s2513.d2");
 
+	test_font( font );
+	STATS_RESET();
+	test_render( font );
+
 	// asm_output out;
 	img_output out( font );
 
@@ -977,39 +6559,38 @@ int main( int argc, char **argv )
 
 	place_t j_large(0,0,1,1,1024,1024);
 
-	for (int i=32;i!=1;i/=2)
-	{
-		place_t pl( 0,0,i,i,1024/i,1024/i );
-		mandelhr( pl, out, font );
-	}
-
-	for (int i=32;i!=0;i/=2)
-	{
-		place_t pl( 0,0,i,i,1024/i,1024/i );
-		mandel( pl, out );
-	}
+	iter_cache = cache.get();
 
-	for (int i=32;i!=0;i/=2)
+	for (int i=32;i!=1;i/=2)
 	{
 		place_t pl( 0,0,i,i,1024/i,1024/i );
-		julia( pl, -0.8, 0.156, out );
+		mandelhr_mt<packed_t>( pl, out, font );
 	}
 
+	escape_map_t map( ESCAPE_MAP_NAME );
 	for (int i=32;i!=0;i/=2)
 	{
 		place_t pl( 0,0,i,i,1024/i,1024/i );
-		julia( pl, -0.55, -0.64, out );
+		mandel_map<packed_t>( pl, out, map );
 	}
 
-	for (int i=32;i!=0;i/=2)
-	{
-		place_t pl( 0,0,i,i,1024/i,1024/i );
-		julia( pl, 0.27, 1.0/256, out );
-	}
+	//	Not julia_zoom: with packed_t, reusing the points of the previous frame
+	//	leaves holes in every other line, and the SIMD groups of the remaining
+	//	points take as long as the whole line did. Only fixed_t gains from it
+	std::pair<double,double> julias[] = { { -0.8, 0.156 }, { -0.55, -0.64 }, { 0.27, 1.0/256 } };
+	for (auto [cx,cy]:julias)
+		for (int i=32;i!=0;i/=2)
+		{
+			place_t pl( 0,0,i,i,1024/i,1024/i );
+			julia_mt<packed_t>( pl, cx, cy, out );
+		}
 
 	// julia( j_large, -0.8, 0.156, out );
 	// julia( j_large, -0.55, -0.64, out );
 	// julia( j_large, 0.27, 1.0/256, out );
 
+	if (cache)
+		std::cout << "Iteration cache: " << cache->hits_ << " hits, " << cache->misses_ << " misses" << std::endl;
+
 	return 0;
 }